@@ -1,10 +1,35 @@
 #include <iostream>
+#include <chrono>
+#include <random>
+#include <new>
+#include <cstdlib>
 #include "src/Client/Client.h"
 #include "src/Server/Server.h"
+#include "src/Server/WorkerPool.h"
 #include "src/common/Args.h"
 #include "src/common/Request.h"
+#include "src/common/RpcCodec.h"
 #include "src/Registry/ServiceRegistry.h"
 
+// 全局堆分配计数，所有线程共享，benchmarkCallAllocations和benchmarkResponseAllocations用它检查路径上是否还有分配
+// 替换全局operator new会作用于整个程序，只在打开REGISTRYCPP_COUNT_ALLOCS时启用；未启用时计数恒为0
+static std::atomic<uint64_t> heapAllocations{0};
+
+#ifdef REGISTRYCPP_COUNT_ALLOCS
+[[gnu::noinline]] void *operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// 不内联，否则GCC看到new与free配对会误报-Wmismatched-new-delete
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+
+[[gnu::noinline]] void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+#endif
+
 int testClient();
 
 void testServer();
@@ -15,17 +40,50 @@ void testFindNearestService(ServiceRegistry &registry);
 
 void testHashService(ServiceRegistry &registry);
 
+void testLoadBalancedService();
+
 void test_compareAndSyncTree();
 
 void test_compareAndSyncTree_with_changes();
 
 void test_compareAndSyncTree_with_changes2();
 
+void testLivenessDeltaValidation();
+
+void testResponseCache();
+
+void benchmarkSerializeServices();
+
+void benchmarkDeserializeServices();
+
+void benchmarkRequestBatching();
+
+void benchmarkCallAllocations();
+
+void benchmarkServerDispatch();
+
+void benchmarkPriorityAdmission();
+
+void benchmarkResponseAllocations();
+
+void benchmarkHedging();
+
 int main() {
 //    ServiceRegistry registry("RegistryA");
 //    testFindBestPerformanceService(registry);
 //    testFindNearestService(registry);
 //    testHashService(registry);
+//    testLoadBalancedService();
+//    testLivenessDeltaValidation();
+//    testResponseCache();
+//    benchmarkSerializeServices();
+//    benchmarkDeserializeServices();
+//    benchmarkRequestBatching();
+//    benchmarkCallAllocations();
+//    benchmarkServerDispatch();
+//    benchmarkPriorityAdmission();
+//    benchmarkResponseAllocations();
+//    benchmarkHedging();
 
     test_compareAndSyncTree_with_changes2();
 
@@ -145,6 +203,34 @@ void testHashService(ServiceRegistry &registry) {
         std::cout << "Service not found or no suitable service: " << response.error << std::endl;
     }
 }
+void testLoadBalancedService() {
+    // 三个实例的在途数分别为0、10、50（由另一个客户端上报），mode 2应明显偏向负载轻的实例、从不选最重的
+    ServiceRegistry registry("RegistryLB");
+    const std::vector<std::string> ids = {"123e4567-e89b-12d3-a456-426614174000",
+                                          "123e4567-e89b-12d3-a456-426614174001",
+                                          "123e4567-e89b-12d3-a456-426614174002"};
+    for (const auto &id : ids) {
+        registry.registerService({"Radar", id, "NodeA", true});
+    }
+    registry.reportLoad("clientB", {InstanceLoad{ids[1], 10}, InstanceLoad{ids[2], 50}});
+
+    Client client;
+    client.setResolver([&registry](const FindServiceRequest &request) { return registry.findService(request); });
+    client.setLoadReporter([&registry](const std::vector<InstanceLoad> &loads) { registry.reportLoad("clientA", loads); });
+
+    FindServiceRequest request("NodeA.RadarService.Radar", ServiceDescriptor(2, LocationInfo{0, 0, ""}, PerformanceMetrics{0, 0, 0}));
+    std::map<std::string, int> picks;
+    Service endpoint;
+    for (int i = 0; i < 3000; ++i) {
+        if (client.resolve(request, &endpoint)) {
+            ++picks[endpoint.instance_id];
+        }
+    }
+    // 两两抽样时最轻的实例只要被抽中就胜出，期望约2/3、1/3、0
+    std::cout << "load 0: " << picks[ids[0]] << ", load 10: " << picks[ids[1]] << ", load 50: " << picks[ids[2]]
+              << (picks[ids[0]] > picks[ids[1]] && picks[ids[1]] > picks[ids[2]] && picks[ids[2]] == 0
+                  ? "  (favours less-loaded)" : "  (UNEXPECTED)") << std::endl;
+}
 
 void test_compareAndSyncTree() {
     // 创建两个ServiceRegistry实例
@@ -373,3 +459,494 @@ void test_compareAndSyncTree_with_changes2() {
 }
 
 
+
+// 构造count个服务，名字和节点在少量取值中重复，接近真实编队的分布
+std::vector<Service> makeBenchmarkServices(size_t count) {
+    std::vector<Service> services;
+    services.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        services.push_back({"Aircraft_Formation_1.Service" + std::to_string(i % 64),
+                            "2f1e7c3a-8b4d-4e6f-9a1b-" + std::to_string(100000000000 + i),
+                            "node" + std::to_string(i % 16),
+                            i % 3 != 0});
+    }
+    return services;
+}
+
+// 对比旧的逐条insert序列化和两遍预分配序列化
+void testLivenessDeltaValidation() {
+    auto count = [](const std::vector<uint8_t> &delta) {
+        LivenessDeltaReader reader(delta);
+        LivenessChange change{};
+        int n = 0;
+        while (reader.next(change)) ++n;
+        return reader.valid() ? n : -1;
+    };
+    auto check = [](const char *name, bool ok) {
+        std::cout << (ok ? "PASS " : "FAIL ") << name << std::endl;
+    };
+
+    // 16个槽位3处变化，位图编码；末尾1字节是新状态位图，前2字节是槽位位图
+    std::vector<uint8_t> bitmap = serializeLivenessDelta("node1", 2, 7, 16, {{1, true}, {5, false}, {9, true}});
+    // 1000个槽位一段连续变化，游程编码；末尾依次是游程(10, 3)和1字节新状态位图
+    std::vector<uint8_t> runs = serializeLivenessDelta("node1", 2, 7, 1000, {{10, true}, {11, true}, {12, false}});
+    check("bitmap delta", count(bitmap) == 3);
+    check("run delta", count(runs) == 3);
+
+    std::vector<uint8_t> damaged = bitmap;
+    damaged.push_back(0);
+    check("trailing byte rejected", count(damaged) == -1);
+
+    damaged = bitmap;
+    damaged.pop_back();
+    check("truncated delta rejected", count(damaged) == -1);
+
+    damaged = bitmap;
+    damaged[damaged.size() - 3] |= 1;
+    check("bitmap popcount mismatch rejected", count(damaged) == -1);
+
+    damaged = runs;
+    damaged[damaged.size() - 2] = 4;
+    check("run sum mismatch rejected", count(damaged) == -1);
+
+    damaged = runs;
+    damaged[damaged.size() - 3] = 0xff;
+    damaged.insert(damaged.end() - 2, 0x0f);
+    check("run beyond slot count rejected", count(damaged) == -1);
+}
+
+void testResponseCache() {
+    auto check = [](const char *name, bool ok) {
+        std::cout << (ok ? "PASS " : "FAIL ") << name << std::endl;
+    };
+
+    // 命中与写方法失效：processRequest在当前线程上执行，按缓存的未命中次数数处理函数的执行次数
+    Server server(1);
+    server.enableResponseCache("Service.getRadarStatus", std::chrono::seconds(10));
+    const ResponseCache &stats = server.responseCache();
+    Request getReq(RequestHeader(MethodId::GetRadarStatus, 1), GetRadarStatusRequest{"ServiceA", "ServiceB"});
+    Request setReq(RequestHeader(MethodId::SetRadarStatus, 2), SetRadarStatusRequest{1, 2});
+    Response first, second, written, third;
+    server.processRequest(getReq, first);
+    server.processRequest(getReq, second);
+    check("second read is a hit", stats.missCount() == 1 && stats.hitCount() == 1 &&
+                                  std::get<GetRadarStatusResponse>(second.responseBody).message ==
+                                  std::get<GetRadarStatusResponse>(first.responseBody).message);
+    server.processRequest(setReq, written);
+    server.processRequest(getReq, third);
+    check("setRadarStatus invalidates the read", written.status == Response::STATUS_SUCCESS &&
+                                                 stats.missCount() == 2 && stats.hitCount() == 1);
+
+    // singleflight：第一个线程执行较慢的处理函数期间，同样参数的其他线程只等它的结果
+    ResponseCache cache;
+    cache.enable(MethodId::GetRadarStatus, std::chrono::seconds(10));
+    std::vector<uint8_t> key;
+    encodeArgs(getReq.body.param, key);
+    std::atomic<int> runs{0};
+    auto slowHandler = [&runs](Response &out) {
+        runs.fetch_add(1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        out.status = Response::STATUS_SUCCESS;
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    std::vector<Response> results(4);
+    std::vector<std::thread> callers;
+    callers.emplace_back([&]() { cache.getOrCompute(MethodId::GetRadarStatus, key, deadline, results[0], slowHandler); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (size_t i = 1; i < results.size(); ++i) {
+        callers.emplace_back([&, i]() { cache.getOrCompute(MethodId::GetRadarStatus, key, deadline, results[i], slowHandler); });
+    }
+    for (auto &caller: callers) caller.join();
+    bool allSucceeded = true;
+    for (const auto &result: results) allSucceeded = allSucceeded && result.status == Response::STATUS_SUCCESS;
+    check("concurrent misses run the handler once", runs.load() == 1 && cache.coalescedCount() == 3 && allSucceeded);
+
+    // 等待以截止时间为限：执行中的flight比截止时间长时，等待方按时返回STATUS_TIMEOUT
+    cache.invalidate(MethodId::GetRadarStatus);
+    runs = 0;
+    std::thread slow([&]() { cache.getOrCompute(MethodId::GetRadarStatus, key, deadline, results[0], slowHandler); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto waitStart = std::chrono::steady_clock::now();
+    cache.getOrCompute(MethodId::GetRadarStatus, key, waitStart + std::chrono::milliseconds(10), results[1], slowHandler);
+    auto waited = std::chrono::steady_clock::now() - waitStart;
+    slow.join();
+    check("waiter gives up at its deadline", runs.load() == 1 && results[1].status == Response::STATUS_TIMEOUT &&
+                                             waited < std::chrono::milliseconds(60) && cache.abandonedCount() == 1);
+}
+
+void benchmarkSerializeServices() {
+    // 旧实现：不预留容量，逐条insert
+    auto serialize_grow = [](const std::vector<Service>& services) {
+        std::vector<uint8_t> result;
+        uint32_t num_services = services.size();
+        result.insert(result.end(), reinterpret_cast<const uint8_t*>(&num_services),
+                      reinterpret_cast<const uint8_t*>(&num_services) + sizeof(num_services));
+        for (const auto& service : services) {
+            auto serialize_string = [&result](const std::string& str) {
+                uint32_t length = str.size();
+                result.insert(result.end(), reinterpret_cast<const uint8_t*>(&length),
+                              reinterpret_cast<const uint8_t*>(&length) + sizeof(length));
+                result.insert(result.end(), str.begin(), str.end());
+            };
+            serialize_string(service.service_name);
+            serialize_string(service.instance_id);
+            serialize_string(service.nodeId);
+            result.push_back(static_cast<uint8_t>(service.is_alive));
+        }
+        return result;
+    };
+
+    auto measure = [](const char* name, int rounds, const auto& fn) {
+        size_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            bytes += fn();
+        }
+        auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "  " << name << ": " << elapsed / rounds << " us/op, "
+                  << bytes / elapsed << " MB/s" << std::endl;
+    };
+
+    for (size_t count : {size_t(10000), size_t(100000)}) {
+        std::vector<Service> services = makeBenchmarkServices(count);
+        int rounds = count >= 100000 ? 20 : 200;
+        std::cout << "[benchmark] serialize " << count << " services, " << serialized_size(services) << " bytes, flat "
+                  << flat_serialized_size(services) << " bytes, compact "
+                  << serializeServicesCompact(services).size() << " bytes" << std::endl;
+
+        measure("insert (old)", rounds, [&]() { return serialize_grow(services).size(); });
+        measure("presized", rounds, [&]() { return serialize_services(services).size(); });
+
+        std::vector<uint8_t> arena;
+        measure("presized arena", rounds, [&]() {
+            serialize_services(services, arena);
+            return arena.size();
+        });
+
+        std::vector<uint8_t> scratch;
+        std::vector<ServiceIoSegment> segments;
+        measure("gather", rounds, [&]() {
+            gather_services(services, scratch, segments);
+            size_t total = 0;
+            for (const auto& segment : segments) total += segment.length;
+            return total;
+        });
+
+        std::vector<uint8_t> flat;
+        measure("flat arena", rounds, [&]() {
+            serializeServicesFlat(services, flat);
+            return flat.size();
+        });
+
+        measure("compact", rounds, [&]() { return serializeServicesCompact(services).size(); });
+    }
+}
+
+// 对比不做检查的旧解码与校验式解码，并用随机损坏的数据做模糊测试
+void benchmarkDeserializeServices() {
+    // 旧实现：直接信任线上的数量和长度
+    auto deserialize_unchecked = [](const std::vector<uint8_t>& data) {
+        size_t offset = 0;
+        uint32_t num_services;
+        std::memcpy(&num_services, &data[offset], sizeof(num_services));
+        offset += sizeof(num_services);
+        std::vector<Service> services;
+        services.reserve(num_services);
+        for (uint32_t i = 0; i < num_services; ++i) {
+            services.push_back(Service::deserialize(data, offset));
+        }
+        return services;
+    };
+
+    std::vector<uint8_t> payload = serialize_services(makeBenchmarkServices(10000));
+    const int rounds = 200;
+
+    auto measure = [&](const char* name, const auto& fn) {
+        size_t count = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            count += fn();
+        }
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "  " << name << ": " << elapsed / rounds << " us/op, "
+                  << payload.size() * rounds / elapsed << " MB/s (" << count / rounds << " services)" << std::endl;
+        return elapsed;
+    };
+
+    std::cout << "[benchmark] deserialize 10000 services, " << payload.size() << " bytes" << std::endl;
+    // 交替测量两次，减少预热顺序带来的偏差
+    measure("unchecked (warmup)", [&]() { return deserialize_unchecked(payload).size(); });
+    double unchecked = measure("unchecked", [&]() { return deserialize_unchecked(payload).size(); });
+    double checked = measure("checked", [&]() { return deserialize_services(payload).size(); });
+
+    double viewOnly = measure("checked views", [&]() {
+        size_t n = 0;
+        for_each_service_checked(payload.data(), payload.size(), [&n](const ServiceView&) { ++n; });
+        return n;
+    });
+    std::cout << "  checked overhead: " << (checked / unchecked - 1.0) * 100 << "%, view-only decode "
+              << viewOnly / unchecked * 100 << "% of unchecked" << std::endl;
+
+    // 模糊测试：随机改写字节或截断，校验式解码必须拒绝或正常返回，不能越界
+    std::mt19937 gen(20240611);
+    size_t rejected = 0;
+    const int cases = 2000;
+    std::vector<Service> out;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < cases; ++i) {
+        std::vector<uint8_t> corrupted = payload;
+        switch (gen() % 3) {
+            case 0:  // 改写若干随机字节
+                for (int k = 0; k < 4; ++k) corrupted[gen() % corrupted.size()] = static_cast<uint8_t>(gen());
+                break;
+            case 1:  // 截断
+                corrupted.resize(gen() % corrupted.size());
+                break;
+            default: {  // 伪造超大的数量或长度
+                uint32_t huge = 0xFFFFFFF0u;
+                size_t at = gen() % 2 ? 0 : 4;
+                std::memcpy(&corrupted[at], &huge, sizeof(huge));
+            }
+        }
+        if (!deserialize_services(corrupted.data(), corrupted.size(), out)) ++rejected;
+    }
+    double fuzz = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "  fuzz: " << cases << " corrupted payloads, " << rejected << " rejected, "
+              << fuzz / cases << " us/op" << std::endl;
+}
+
+void benchmarkRequestBatching() {
+    // 同样数量的小请求，对比逐条发帧与合并发帧的吞吐，以及空闲链路上单次调用的延迟
+    auto measure = [](const char* name, BatchPolicy policy) {
+        const int calls = 100000;
+        const int window = 2048;  // 在途调用数上限，避免超过pending表容量
+        Client client(policy);
+        std::atomic<int> done{0};
+        std::atomic<int> failed{0};
+        auto onResponse = [&](const Response& r) {
+            if (r.status != Response::STATUS_SUCCESS) ++failed;
+            ++done;
+        };
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i) {
+            while (i - done.load() >= window) std::this_thread::yield();
+            client.CallAsync("Service.getRadarStatus", GetRadarStatusRequest{}, onResponse);
+        }
+        while (done.load() < calls) std::this_thread::sleep_for(std::chrono::microseconds(50));
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));  // 让链路回到空闲
+        Response reply;
+        auto callStart = std::chrono::steady_clock::now();
+        client.Call("Service.getRadarStatus", GetRadarStatusRequest{}, &reply);
+        double latency = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - callStart).count();
+
+        std::cerr << name << ": " << calls / seconds << " calls/s, " << failed.load() << " failed, idle call "
+                  << latency << " us" << std::endl;
+        return calls / seconds;
+    };
+
+    BatchPolicy unbatched;
+    unbatched.maxMessages = 1;
+    double single = measure("one request per frame", unbatched);
+    double batched = measure("batched (64 / 200us)", BatchPolicy());
+    std::cerr << "  speedup: " << batched / single << "x" << std::endl;
+}
+
+void benchmarkCallAllocations() {
+#ifndef REGISTRYCPP_COUNT_ALLOCS
+    std::cerr << "benchmarkCallAllocations requires REGISTRYCPP_COUNT_ALLOCS" << std::endl;
+    return;
+#endif
+    // 同步调用在稳态下的堆分配次数：预热让池、各缓冲区长到稳定容量，再统计后续调用
+    // 时间轮的每个槽位第一次被用到时会分配，预热要让它转满一圈
+    const auto warmup = std::chrono::seconds(11);
+    const int calls = 20000;
+    Client client;
+    auto measure = [&](const char* name, auto&& call) {
+        for (auto until = std::chrono::steady_clock::now() + warmup; std::chrono::steady_clock::now() < until;) call();
+        uint64_t before = heapAllocations.load();
+        auto start = std::chrono::steady_clock::now();
+        int failed = 0;
+        for (int i = 0; i < calls; ++i) {
+            if (!call()) ++failed;
+        }
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        uint64_t allocations = heapAllocations.load() - before;
+        std::cerr << name << ": " << double(allocations) / calls << " allocations/call, " << micros / calls
+                  << " us/call, " << failed << " failed" << std::endl;
+    };
+
+    GetRadarStatusRequest args{"ServiceA.RadarClient", "ServiceB.RadarService"};
+    const std::string method = "Service.getRadarStatus";  // 直接传字面量时每次都会构造一个std::string
+    Response reply;
+    measure("Call(method, args, &reply)", [&]() {
+        return client.Call(method, args, &reply);
+    });
+    RpcResult<GetRadarStatusResponse> result;
+    measure("call<GetRadarStatus>(args, result)", [&]() {
+        return client.call<GetRadarStatus>(args, result);
+    });
+}
+
+void benchmarkServerDispatch() {
+    // 同一个64条请求的帧反复交给processFrame，析构Server时线程池处理完全部任务，以此计时
+    FrameBatchWriter batch;
+    std::vector<uint8_t> message;
+    for (int i = 0; i < 64; ++i) {
+        Request req(RequestHeader(MethodId::GetRadarStatus, i), GetRadarStatusRequest{"ServiceA", "ServiceB"});
+        encodeRequest(req, message);
+        batch.append(message);
+    }
+    const int frames = 2000;
+    for (size_t threads : {size_t(1), size_t(std::thread::hardware_concurrency())}) {
+        auto start = std::chrono::steady_clock::now();
+        {
+            Server server(threads);
+            for (int f = 0; f < frames; ++f) {
+                server.processFrame(batch.bytes().data(), batch.bytes().size());
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << threads << " worker thread(s): " << frames * 64 / seconds << " requests/s" << std::endl;
+    }
+}
+
+void benchmarkPriorityAdmission() {
+    // 低优先级任务持续灌满线程池，同时每毫秒提交一个关键任务，统计关键任务从提交到开始执行的等待
+    // 对照组把所有任务放进同一条通道，即没有优先级时的情况
+    auto spin = [](std::chrono::microseconds d) {
+        auto until = std::chrono::steady_clock::now() + d;
+        while (std::chrono::steady_clock::now() < until) {}
+    };
+    auto measure = [&](const char* name, bool lanes) {
+        WorkerPool pool(2, lanes ? std::vector<size_t>{256, 1024, 256} : std::vector<size_t>{1024});
+        size_t bulkLane = lanes ? static_cast<size_t>(Priority::Bulk) : 0;
+        std::atomic<bool> stop{false};
+        std::atomic<int> rejected{0};
+        std::thread flood([&]() {
+            while (!stop) {
+                if (!pool.submit(bulkLane, [&]() { spin(std::chrono::microseconds(20)); })) {
+                    ++rejected;
+                    std::this_thread::yield();
+                }
+            }
+        });
+        std::vector<double> waits(500);
+        std::atomic<int> finished{0};
+        for (auto& wait : waits) {
+            auto submitted = std::chrono::steady_clock::now();
+            bool accepted = pool.submit(0, [&wait, submitted, &finished]() {
+                wait = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - submitted).count();
+                ++finished;
+            });
+            if (!accepted) {
+                wait = -1;
+                ++finished;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        while (finished < static_cast<int>(waits.size())) std::this_thread::yield();
+        stop = true;
+        flood.join();
+        long dropped = std::count(waits.begin(), waits.end(), -1.0);
+        std::sort(waits.begin(), waits.end());
+        std::cerr << name << ": critical wait p50=" << waits[waits.size() / 2] << "us p99="
+                  << waits[waits.size() * 99 / 100] << "us, critical rejected " << dropped
+                  << ", bulk rejected " << rejected.load() << std::endl;
+    };
+    measure("single queue", false);
+    measure("priority lanes", true);
+}
+
+void benchmarkResponseAllocations() {
+#ifndef REGISTRYCPP_COUNT_ALLOCS
+    std::cerr << "benchmarkResponseAllocations requires REGISTRYCPP_COUNT_ALLOCS" << std::endl;
+    return;
+#endif
+    // 服务端的堆分配次数：先统计handler本身（dispatch到同一个回复槽位），再统计processFrame整条路径
+    // 整条路径按每个方法的端到端计数等待一帧处理完，预热让FrameJob和各缓冲区长到稳定容量
+    Server server(1);
+    Request getReq(RequestHeader(MethodId::GetRadarStatus, 1), GetRadarStatusRequest{"ServiceA.RadarClient", "ServiceB.RadarService"});
+    Request setReq(RequestHeader(MethodId::SetRadarStatus, 2), SetRadarStatusRequest{123456, -7890});
+    Response slot;
+    const int calls = 100000;
+    for (Request* req : {&getReq, &setReq}) {
+        for (int i = 0; i < 1000; ++i) server.dispatch(*req, slot);
+        uint64_t before = heapAllocations.load();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i) server.dispatch(*req, slot);
+        double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << methodNameOf(req->header.methodId) << " handler: "
+                  << double(heapAllocations.load() - before) / calls << " allocations/call, " << nanos / calls
+                  << " ns/call" << std::endl;
+    }
+
+    FrameBatchWriter batch;
+    std::vector<uint8_t> message;
+    for (int i = 0; i < 64; ++i) {
+        encodeRequest(i % 2 ? setReq : getReq, message);
+        batch.append(message);
+    }
+    const MethodType& stats = server.methodStats()[MethodId::GetRadarStatus];
+    auto runFrames = [&](int frames) {
+        for (int f = 0; f < frames; ++f) {
+            uint64_t expected = stats.endToEnd.count() + 32;
+            server.processFrame(batch.bytes().data(), batch.bytes().size());
+            while (stats.endToEnd.count() < expected) std::this_thread::yield();
+        }
+    };
+    const int frames = 2000;
+    runFrames(200);
+    uint64_t before = heapAllocations.load();
+    runFrames(frames);
+    std::cerr << "processFrame: " << double(heapAllocations.load() - before) / (frames * 64)
+              << " allocations/request" << std::endl;
+}
+
+void benchmarkHedging() {
+    // 模拟对端按比例不回复请求，这些调用不对冲时只能等到超时；对冲后由第二个实例挽回
+    // 另外两组分别是丢失率远超预算和没有第二个实例（查询失败退还预算，不对冲）
+    // 丢失率超过5%时被撤销和超时的主调用把p95推到超时附近，对冲自行停止；预算一组按p50对冲，对冲数由HedgeBudget限制在约5% + burst
+    const auto timeout = std::chrono::milliseconds(100);
+    const Service primary{"Radar", "123e4567-e89b-12d3-a456-426614174000", "NodeA", true};
+    const Service backup{"Radar", "123e4567-e89b-12d3-a456-426614174001", "NodeB", true};
+    const std::string method = "Service.getRadarStatus";
+    GetRadarStatusRequest args{"ServiceA.RadarClient", "ServiceB.RadarService"};
+
+    auto measure = [&](const char* name, double loss, double quantile, bool secondInstance, int calls) {
+        Client client;
+        std::atomic<int> hedges{0};
+        client.setResolver([&](const FindServiceRequest&) {
+            ++hedges;  // 只有取到预算的对冲才会查询第二个实例
+            if (!secondInstance) {
+                return Response(0, Response::STATUS_NOT_FOUND, "", RespVariant{});
+            }
+            return Response(0, Response::STATUS_SUCCESS, "", FindServiceResponse{Response::STATUS_SUCCESS, backup});
+        });
+        if (quantile > 0) {
+            HedgePolicy policy;
+            policy.quantile = quantile;
+            // mode 2不缓存解析结果，每次对冲都会经过resolver
+            policy.lookup = FindServiceRequest("NodeA.RadarService.Radar",
+                                               ServiceDescriptor(2, LocationInfo{0, 0, ""}, PerformanceMetrics{0, 0, 0}));
+            client.setHedgePolicy(method, policy);
+        }
+        client.setMockLoss(loss);
+        std::vector<double> latencies;
+        int failed = 0;
+        Response reply;
+        for (int i = 0; i < calls; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            if (!client.Call(primary, method, args, &reply, timeout)) ++failed;
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        std::cerr << name << ": p50=" << latencies[calls / 2] << "ms p99=" << latencies[calls * 99 / 100]
+                  << "ms, " << failed << "/" << calls << " failed, " << hedges.load() << " hedge lookups" << std::endl;
+    };
+    measure("no hedging, 2% loss", 0.02, 0, true, 1000);
+    measure("hedged at p95, 2% loss", 0.02, 0.95, true, 1000);
+    measure("hedged at p50, 30% loss (budget-bound)", 0.30, 0.5, true, 300);
+    measure("hedged at p95, 2% loss, no second instance", 0.02, 0.95, false, 1000);
+}
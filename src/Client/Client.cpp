@@ -5,6 +5,7 @@
 
 #include "Client.h"
 #include "../common/Args.h"
+#include "../common/RpcCodec.h"
 
 //    uint64_t seq;
 //    {
@@ -25,54 +26,284 @@
 //    *reply = last_response;  // 设置响应
 //    return true;
 
-void sendByDDS(const std::shared_ptr<Request> &request);
-
-Client::Client() {
+Client::Client(BatchPolicy batchPolicy) : batchPolicy(batchPolicy) {
+    methodPriorities.fill(Priority::Normal);
+    methodPriorities[static_cast<size_t>(MethodId::SetRadarStatus)] = Priority::Critical;  // 控制类调用
     // Launching the receiveFromDDS method in a separate thread
-    std::thread(&Client::receiveFromDDS, this).detach();
+    receiverThread = std::thread(&Client::receiveFromDDS, this);
+    senderThread = std::thread(&Client::senderLoop, this);
 }
 
 Client::~Client() {
     // Set shutdown or closing flags to true to stop the thread
     shutdown = true;
+    {
+        std::lock_guard<std::mutex> lock(hedgeMtx);
+        hedgeStopping = true;
+    }
+    hedgeCv.notify_one();
+    if (hedgeThread.joinable()) {
+        hedgeThread.join();  // 对冲线程会往发送队列放请求，先于发送线程停止
+    }
+    {
+        std::lock_guard<std::mutex> lock(senderMtx);
+        senderIdle = false;
+    }
+    senderCv.notify_one();
+    senderThread.join();  // 发送线程会先把队列中剩余的请求发完
+    responseChannel.close();
+    receiverThread.join();  // 接收线程处理完已到达的响应后退出
 }
 
-bool Client::Call(const std::string &method, const GetRadarStatusRequest &args, Response *reply) {
+std::shared_ptr<Request> Client::acquireRequest(const Service *endpoint) {
+    auto request = requests.acquire();
+    if (endpoint) {
+        request->inflight = inflight.counter(endpoint->instance_id);
+    }
+    return request;
+}
+
+std::shared_ptr<Request> Client::makeRequest(const Service *endpoint, const RequestHeader &header,
+                                             const ArgVariant &args) {
+    auto request = acquireRequest(endpoint);
+    request->header.serviceMethod = header.serviceMethod;
+    request->header.methodId = header.methodId;
+    request->header.priority = header.priority;
+    request->body.param = args;
+    return request;
+}
 
-// 创建请求头部
-    RequestHeader header(method, seq++, "");
+bool Client::Call(const std::string &method, const GetRadarStatusRequest &args, Response *reply,
+                  std::chrono::milliseconds timeout) {
+    auto request = makeRequest(nullptr, method, args);
+    *reply = callBlocking(nullptr, request, timeout);  // 赋值沿用reply已有的容量
+    return checkReply(*reply);
+}
 
-    // 创建请求对象
-    auto request = std::make_shared<Request>(header, args);
+bool Client::Call(const Service &endpoint, const std::string &method, const GetRadarStatusRequest &args,
+                  Response *reply, std::chrono::milliseconds timeout) {
+    auto request = makeRequest(&endpoint, method, args);
+    *reply = callBlocking(&endpoint, request, timeout);
+    return checkReply(*reply);
+}
 
-    // 使用std::future来等待响应
-    auto future = request->get_future();
+const Response &Client::callBlocking(const Service *endpoint, const std::shared_ptr<Request> &request,
+                                     std::chrono::milliseconds timeout) {
+    HedgeSettings *hedge = endpoint ? hedgeSettingsFor(request->header.methodId) : nullptr;
+    if (!hedge) {
+        // 超时由时间轮负责，到期后以STATUS_TIMEOUT完成
+        send(request, timeout);
+        return request->wait();
+    }
+    // 主请求的回调交给了对冲逻辑，它的completion空着；两份请求中先完成的一份通过deliver设置它
+    Completion &completion = request->completion;
+    callHedged(*hedge, request, *endpoint, [&completion](const Response &r) { completion.set(r); }, timeout);
+    return completion.wait();
+}
 
-    // 发送请求
-    send(request);
-    try {
-        // 等待响应或超时
-        if (future.wait_for(std::chrono::seconds(6)) != std::future_status::ready) {
-            // 超时处理
-            std::cerr << "Request timed out." << std::endl;
-            removeRequest(request->header.seq); // 从pending中移除
-            reply->error = "Request timed out.";
-            return false;
-        }
-        // 获取响应
-        *reply = future.get();  // 可能抛出异常，如果promise被设置为异常
-        // 检查响应中的错误字段
-        if (reply->status != Response::STATUS_SUCCESS) {
-            std::cerr << "Error from Server: " << reply->error << std::endl;
-            return false;
-        }
-//        std::cout << "-------"<<reply->status<<std::endl;
-        return true;  // 成功处理请求
-    } catch (const std::exception &e) {
-        // 处理可能的异常
-        std::cerr << "Exception while waiting for message: " << e.what() << std::endl;
+bool Client::checkReply(const Response &reply) {
+    // 检查响应中的错误字段
+    if (reply.status == Response::STATUS_TIMEOUT) {
+        std::cerr << "Request timed out." << std::endl;
         return false;
     }
+    if (reply.status != Response::STATUS_SUCCESS) {
+        std::cerr << "Error from Server: " << (reply.error.empty() ? Response::statusText(reply.status) : reply.error.c_str())
+                  << std::endl;
+        return false;
+    }
+    return true;  // 成功处理请求
+}
+
+void Client::CallAsync(const std::string &method, const GetRadarStatusRequest &args, ResponseCallback callback,
+                       std::chrono::milliseconds timeout) {
+    // 不等待，完成时由接收线程调用callback，超时则由计时线程调用
+    callAsync(nullptr, makeRequest(nullptr, method, args), std::move(callback), timeout);
+}
+
+void Client::CallAsync(const Service &endpoint, const std::string &method, const GetRadarStatusRequest &args,
+                       ResponseCallback callback, std::chrono::milliseconds timeout) {
+    callAsync(&endpoint, makeRequest(&endpoint, method, args), std::move(callback), timeout);
+}
+
+void Client::callAsync(const Service *endpoint, const std::shared_ptr<Request> &request, ResponseCallback callback,
+                       std::chrono::milliseconds timeout) {
+    if (HedgeSettings *hedge = endpoint ? hedgeSettingsFor(request->header.methodId) : nullptr) {
+        callHedged(*hedge, request, *endpoint, std::move(callback), timeout);
+        return;
+    }
+    request->callback = std::move(callback);
+    send(request, timeout);
+}
+
+// 一次可对冲的调用：主调用和对冲请求共享，先到的成功响应交给deliver
+struct Client::HedgedCall {
+    HedgeSettings *settings = nullptr;
+    Service primary;
+    RequestHeader header;  // 发对冲请求时复制一份，seq另行分配
+    ArgVariant args;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point deadline;
+    ResponseCallback deliver;
+    std::atomic<bool> done{false};
+    std::atomic<int> outstanding{1};
+    std::atomic<uint64_t> seqs[2]{};  // 0为主调用，1为对冲请求
+};
+
+bool Client::setHedgePolicy(const std::string &method, HedgePolicy policy) {
+    auto index = static_cast<size_t>(methodIdOf(method));
+    if (index == 0) {
+        std::cerr << "Cannot hedge unknown method " << method << std::endl;
+        return false;
+    }
+    auto settings = std::make_unique<HedgeSettings>();
+    settings->latency.setQuantile(policy.quantile);
+    settings->policy = std::move(policy);
+    hedgePolicies[index] = std::move(settings);
+    if (!hedgeThread.joinable()) {
+        hedgeThread = std::thread(&Client::hedgeLoop, this);
+    }
+    return true;
+}
+
+bool Client::setMethodPriority(const std::string &method, Priority priority) {
+    auto index = static_cast<size_t>(methodIdOf(method));
+    if (index == 0) {
+        std::cerr << "Cannot set priority of unknown method " << method << std::endl;
+        return false;
+    }
+    methodPriorities[index] = priority;
+    return true;
+}
+
+Client::HedgeSettings *Client::hedgeSettingsFor(MethodId id) const {
+    auto index = static_cast<size_t>(id);
+    return index < hedgePolicies.size() ? hedgePolicies[index].get() : nullptr;
+}
+
+void Client::callHedged(HedgeSettings &settings, const std::shared_ptr<Request> &request, const Service &endpoint,
+                        ResponseCallback deliver, std::chrono::milliseconds timeout) {
+    auto call = std::make_shared<HedgedCall>();
+    call->settings = &settings;
+    call->primary = endpoint;
+    call->header = request->header;
+    call->args = request->body.param;
+    call->start = std::chrono::steady_clock::now();
+    call->deadline = call->start + timeout;
+    call->deliver = std::move(deliver);
+    hedgeBudget.deposit();
+
+    request->callback = [this, call](const Response &r) { finishHedged(call, 0, r); };
+    send(request, timeout);
+    if (call->done) {
+        return;  // 发送失败或已经响应
+    }
+    uint64_t primarySeq = request->header.seq;
+    call->seqs[0] = primarySeq;
+
+    auto p95 = settings.latency.percentile(settings.policy.initialDelay);
+    auto delay = std::max(settings.policy.minDelay, std::chrono::ceil<std::chrono::milliseconds>(p95));
+    if (delay >= timeout) {
+        return;  // 主调用超时之前来不及对冲
+    }
+    {
+        std::lock_guard<std::mutex> lock(hedgeMtx);
+        hedgeWaiting[primarySeq] = call;
+    }
+    if (!timeouts.schedule(primarySeq | HEDGE_TIMER, delay)) {
+        std::lock_guard<std::mutex> lock(hedgeMtx);
+        hedgeWaiting.erase(primarySeq);
+    }
+}
+
+void Client::fireHedge(uint64_t primarySeq) {
+    std::shared_ptr<HedgedCall> call;
+    {
+        std::lock_guard<std::mutex> lock(hedgeMtx);
+        auto it = hedgeWaiting.find(primarySeq);
+        if (it == hedgeWaiting.end()) {
+            return;
+        }
+        call = std::move(it->second);
+        hedgeWaiting.erase(it);
+    }
+    if (call->done || !hedgeBudget.tryWithdraw()) {
+        return;
+    }
+
+    FindServiceRequest lookup = call->settings->policy.lookup;
+    lookup.exclude_instance = call->primary.instance_id;
+    Service second;
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(call->deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0 || !resolve(lookup, &second)) {
+        hedgeBudget.refund();  // 没有第二个实例可用，不消耗预算
+        return;
+    }
+
+    auto hedge = makeRequest(&second, call->header, call->args);
+    hedge->callback = [this, call](const Response &r) { finishHedged(call, 1, r); };
+    call->outstanding.fetch_add(1);
+    send(hedge, remaining);
+    call->seqs[1] = hedge->header.seq;
+    if (call->done) {
+        takePending(hedge->header.seq);  // 主调用恰好在对冲发出时完成
+    }
+}
+
+void Client::hedgeLoop() {
+    std::vector<uint64_t> ready;
+    std::unique_lock<std::mutex> lock(hedgeMtx);
+    while (true) {
+        hedgeCv.wait(lock, [this]() { return hedgeStopping || !hedgeReady.empty(); });
+        if (hedgeStopping) {
+            break;
+        }
+        // 交换后两个数组的容量都保留，稳态下登记到期的seq不再分配
+        ready.swap(hedgeReady);
+        lock.unlock();
+        for (uint64_t primarySeq : ready) {
+            fireHedge(primarySeq);
+        }
+        ready.clear();
+        lock.lock();
+    }
+}
+
+void Client::finishHedged(const std::shared_ptr<HedgedCall> &call, int which, const Response &response) {
+    auto elapsed = [&call]() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - call->start);
+    };
+    // 超时的主调用按截止时间计入，真实延迟至少这么长
+    if (which == 0 && (response.status == Response::STATUS_SUCCESS || response.status == Response::STATUS_TIMEOUT)) {
+        call->settings->latency.record(elapsed());
+    }
+    int remaining = call->outstanding.fetch_sub(1) - 1;
+    if (response.status != Response::STATUS_SUCCESS && remaining > 0) {
+        return;  // 另一份还可能成功，等它的结果
+    }
+    if (call->done.exchange(true)) {
+        return;
+    }
+    // 撤销还没有响应的另一份，释放它的pending槽位和在途计数
+    uint64_t other = call->seqs[1 - which].load();
+    if (other && takePending(other) && which == 1) {
+        // 主调用输给了对冲，按撤销时已经等待的时间计入（删失样本）
+        // 只统计赢得比赛的主调用时，样本被截断在对冲延迟附近，分位数会一路降到minDelay
+        call->settings->latency.record(elapsed());
+    }
+    call->deliver(response);
+}
+
+void Client::onTimer(uint64_t key) {
+    if (key & HEDGE_TIMER) {
+        {
+            std::lock_guard<std::mutex> lock(hedgeMtx);
+            hedgeReady.push_back(key & ~HEDGE_TIMER);
+        }
+        hedgeCv.notify_one();
+    } else {
+        expireRequest(key);
+    }
 }
 
 //void Client::sendDDS(const Request& req) {
@@ -97,93 +328,319 @@ bool Client::Call(const std::string &method, const GetRadarStatusRequest &args,
 //    cv.notify_all();  // 通知等待的Call方法
 //}
 
+void Client::setResolver(std::function<Response(const FindServiceRequest &)> findService) {
+    resolver = std::move(findService);
+}
+
+void Client::setLoadReporter(std::function<void(const std::vector<InstanceLoad> &)> report) {
+    loadReporter = std::move(report);
+}
+
+void Client::reportLoad() {
+    if (!loadReporter) {
+        return;
+    }
+    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+    int64_t last = lastLoadReport.load(std::memory_order_relaxed);
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(LOAD_REPORT_INTERVAL).count();
+    if (last != 0 && now - last < interval) {
+        return;
+    }
+    // 多个线程同时到期时只有一个上报
+    if (lastLoadReport.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        loadReporter(inflight.snapshot());
+    }
+}
+
+bool Client::resolve(const FindServiceRequest &request, Service *endpoint) {
+    bool cacheable = request.descriptor.mode != 2;  // 负载均衡模式每次都要重新抽样
+    if (cacheable && endpoints.lookup(request, *endpoint)) {
+        return true;
+    }
+    if (!resolver) {
+        std::cerr << "No resolver set, cannot find " << request.service_name << std::endl;
+        return false;
+    }
+
+    if (!cacheable) {
+        reportLoad();  // registry按上报的在途数抽样，先让它看到本客户端的最新值
+    }
+    uint64_t generation = endpoints.generation(request.service_name);
+    Response response = resolver(request);
+    auto *found = std::get_if<FindServiceResponse>(&response.responseBody);
+    if (response.status != Response::STATUS_SUCCESS || !found) {
+        return false;  // 查找失败不缓存，下次仍然询问registry
+    }
+    *endpoint = found->service;
+    if (cacheable) {
+        endpoints.store(request, found->service, generation);
+    }
+    return true;
+}
+
+void Client::onServiceChanged(const std::string &serviceType) {
+    endpoints.invalidate(serviceType);
+}
+
 bool Client::IsAvailable() const {
     return !this->closing && !this->shutdown;
 }
 
+std::vector<InstanceLoad> Client::inflightSnapshot() const {
+    return inflight.snapshot();
+}
+
+std::shared_ptr<Request> Client::takePending(uint64_t req_seq) {
+    auto request = pending.take(req_seq);  // 无锁取出，与响应完成之间只有一方能拿到
+    if (request && request->inflight) {
+        request->inflight->fetch_sub(1, std::memory_order_relaxed);
+    }
+    return request;
+}
+
 std::shared_ptr<Request> Client::removeRequest(uint64_t req_seq) {
-    std::lock_guard<std::mutex> lock(mtx);  // 使用锁确保线程安全
-    auto it = pending.find(req_seq);
-    if (it != pending.end()) {
-        auto request = it->second;
-        pending.erase(it);  // 如果找到，从映射中删除
-        return request;  // 返回找到的请求
-    } else {
+    auto request = takePending(req_seq);
+    if (!request) {
         // 如果没有找到对应的请求，打印日志消息
         std::cerr << "Request with Seq " << req_seq << " not found, might have timed out or been terminated already."
                   << std::endl;
-        return nullptr;  // 返回空指针
     }
+    return request;  // 返回找到的请求
 }
 
 uint64_t Client::registerRequest(const std::shared_ptr<Request> &request) {
-    std::lock_guard<std::mutex> lock(mtx);
     if (closing || shutdown) {
         throw std::runtime_error("Client is shutting down");
     }
-    request->header.seq = this->seq++;
-    pending[request->header.seq] = request;
+    request->header.seq = this->seq.fetch_add(1, std::memory_order_relaxed);
+    if (!pending.insert(request->header.seq, request)) {
+        throw std::runtime_error("Too many pending requests");
+    }
     return request->header.seq;
 }
 
-void Client::send(const std::shared_ptr<Request> &request) {
-    std::thread([request, this]() {
-        try {
-            uint64_t seq = registerRequest(request);  // 注册这个请求并获得序列号
-            // 省略实际的网络发送逻辑，仅模拟调用
-            sendByDDS(request);  // 发送请求通过DDS
-            std::cout << "[send] DDS sent success" << std::endl;
-            // 不再在这里处理响应
-        } catch (const std::exception &e) {
-            checkPendingRequests(); //检查是否正确register
-            // 发生异常，设置异常信息并完成请求
-            GetRadarStatusResponse errorResponse;  // 创建一个默认的响应对象来表示错误
-            Response response(request->header.seq, 500, e.what(), errorResponse);  // 设置错误响应
-            request->complete(response);  // 完成请求，设置错误响应
+void Client::send(const std::shared_ptr<Request> &request, std::chrono::milliseconds timeout) {
+    request->sentAt = std::chrono::steady_clock::now();
+    // 注册之前计入在途数，响应可能在registerRequest返回前就到达并减掉它
+    if (request->inflight) {
+        request->inflight->fetch_add(1, std::memory_order_relaxed);
+    }
+    try {
+        registerRequest(request);  // 注册这个请求并获得序列号
+    } catch (const std::exception &e) {
+        if (request->inflight) {
+            request->inflight->fetch_sub(1, std::memory_order_relaxed);
+        }
+        checkPendingRequests(); //检查是否正确register
+        // 发生异常，设置异常信息并完成请求
+        GetRadarStatusResponse errorResponse;  // 创建一个默认的响应对象来表示错误
+        Response response(request->header.seq, 500, e.what(), errorResponse);  // 设置错误响应
+        recordFailure(*request);
+        request->complete(response);  // 完成请求，设置错误响应
+        return;
+    }
+
+    // 截止时间随请求发给服务端（按剩余时间编码），过期后服务端不再执行也不再回复
+    request->header.deadline = std::chrono::steady_clock::now() + timeout;
+
+    // 先登记超时再入队，保证发出去的请求一定会被完成
+    if (!timeouts.schedule(request->header.seq, timeout)) {
+        if (removeRequest(request->header.seq)) {
+            GetRadarStatusResponse errorResponse;
+            Response response(request->header.seq, 500, "Timer queue is full.", errorResponse);
+            recordFailure(*request);
+            request->complete(response);
+        }
+        return;
+    }
+
+    // 队列满时短暂让出CPU等待发送线程追上，仍然满则直接失败，不无限阻塞调用方
+    for (int attempt = 0; !sendQueue.tryPush(request); ++attempt) {
+        if (attempt == 1000) {
+            // 超时可能已经抢先完成了这个调用
+            if (removeRequest(request->header.seq)) {
+                GetRadarStatusResponse errorResponse;
+                Response response(request->header.seq, 500, "Send queue is full.", errorResponse);
+                recordFailure(*request);
+                request->complete(response);
+            }
+            return;
+        }
+        wakeSender();
+        std::this_thread::yield();
+    }
+    wakeSender();
+}
+
+void Client::expireRequest(uint64_t req_seq) {
+    // 响应已经到达时take返回空，定时器直接作废
+    auto request = takePending(req_seq);
+    if (request) {
+        GetRadarStatusResponse errorResponse;
+        Response response(req_seq, Response::STATUS_TIMEOUT, "Request timed out.", errorResponse);
+        recordFailure(*request);
+        request->complete(response);
+    }
+}
+
+void Client::recordFailure(const Request &request) {
+    // 超时或没能发出，只计端到端和错误；framedAt可能还没写入，不读取
+    MethodType &method = stats[request.header.methodId];
+    method.endToEnd.record(std::chrono::steady_clock::now() - request.sentAt);
+    method.errors.add();
+}
+
+void Client::wakeSender() {
+    // 与senderLoop中的写入配对：入队后再检查idle，保证不会丢失唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (senderIdle.load(std::memory_order_relaxed)) {
+        {
+            std::lock_guard<std::mutex> lock(senderMtx);
+            senderIdle = false;
         }
-    }).detach();
+        senderCv.notify_one();
+    }
 }
 
-void Client::checkPendingRequests() {
-    std::lock_guard<std::mutex> lock(mtx); // 保证线程安全
-    std::cout << "Total pending requests: " << pending.size() << std::endl;
+void Client::senderLoop() {
+    using Clock = std::chrono::steady_clock;
+    FrameBatchWriter batch;
+    std::vector<uint8_t> message;  // 单条请求的编码缓冲区，复用
+    Clock::time_point firstQueued;
+    Clock::time_point lastFlush;
+
+    while (true) {
+        std::shared_ptr<Request> request;
+        while (!batch.full(batchPolicy) && sendQueue.tryPop(request)) {
+            if (batch.empty()) {
+                firstQueued = Clock::now();
+            }
+            encodeRequest(*request, message);
+            batch.append(message);
+            request->framedAt = Clock::now();
+        }
+
+        if (!batch.empty()) {
+            auto now = Clock::now();
+            bool linkIdle = now - lastFlush >= batchPolicy.maxDelay;
+            if (batch.full(batchPolicy) || linkIdle || shutdown || now - firstQueued >= batchPolicy.maxDelay) {
+                sendByDDS(batch);
+                batch.clear();
+                lastFlush = Clock::now();
+                continue;
+            }
+        } else if (shutdown) {
+            break;
+        }
 
-    for (const auto &pair: pending) {
-        std::cout << "Request Seq: " << pair.first << std::endl;
-        // 假设Request类有一个名为getDescription的方法来提供请求的详细描述
-        // std::cout << "Request Detail: " << pair.second->getDescription() << std::endl;
+        std::unique_lock<std::mutex> lock(senderMtx);
+        senderIdle = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // 声明休眠之后再检查一次，避免错过刚入队的请求
+        if (!sendQueue.empty() || shutdown) {
+            senderIdle = false;
+            continue;
+        }
+        auto woken = [this]() { return !senderIdle || shutdown; };
+        if (batch.empty()) {
+            senderCv.wait(lock, woken);
+        } else {
+            // 帧里还有未发出的请求，最多等到maxDelay到期
+            senderCv.wait_until(lock, firstQueued + batchPolicy.maxDelay, woken);
+        }
+        senderIdle = false;
     }
 }
 
+void Client::checkPendingRequests() {
+    size_t total = 0;
+    pending.forEachSeq([&total](uint64_t reqSeq) {
+        std::cout << "Request Seq: " << reqSeq << std::endl;
+        ++total;
+    });
+    std::cout << "Total pending requests: " << total << std::endl;
+}
+
 void Client::terminateRequests(const std::string &err) {
 
 }
 
 void Client::receiveFromDDS() {
-    // 模拟从DDS接收数据
-    // TODO
-    // 根据实际的DDS接收逻辑来调整
-    while (!shutdown) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(5000));  // 模拟接收延迟
-        Response response;
-        if (!pending.empty()) {
-            std::cout << "[Simulation] Receive response from dds" << std::endl;
-            auto it = pending.begin();
-            auto request = it->second;
+    std::vector<DdsChannel::Frame> frames;
+    Response response;
+    auto completeOne = [this, &response](const uint8_t *data, size_t size) {
+        if (!decodeResponse(data, size, response)) {
+            std::cerr << "Malformed response dropped (" << size << " bytes)" << std::endl;
+            return;
+        }
+        // 与超时竞争取出请求，拿到的一方负责完成它；已超时的迟到响应直接丢弃
+        auto request = takePending(response.seq);
+        if (request) {
+            MethodType &method = stats[request->header.methodId];
+            auto now = std::chrono::steady_clock::now();
+            method.queue.record(request->framedAt - request->sentAt);
+            method.handler.record(now - request->framedAt);
+            method.endToEnd.record(now - request->sentAt);
+            if (response.status != Response::STATUS_SUCCESS) {
+                method.errors.add();
+            }
+            request->complete(response);
+        }
+    };
+    // 没有响应时阻塞，不轮询；一次唤醒处理期间到达的所有帧
+    while (responseChannel.receive(frames)) {
+        for (const auto &frame: frames) {
+            if (!forEachBatchedMessage(frame.data(), frame.size(), completeOne)) {
+                std::cerr << "Malformed response frame (" << frame.size() << " bytes)" << std::endl;
+            }
+        }
+        responseChannel.recycle(frames);
+    }
+}
+
+// 模拟对端的固定回复，原地写入复用的Response
+template<typename Body>
+static void fillMockReply(Response &response) {
+    auto *body = std::get_if<Body>(&response.responseBody);
+    if (!body) {
+        body = &response.responseBody.emplace<Body>();
+    }
+    body->status = Response::STATUS_SUCCESS;
+    body->message = "Operation successful";
+}
 
-            GetRadarStatusResponse mockResponse{200, "Operation successful"};
-            response.seq = request->header.seq;
-            response.status = mockResponse.status;
-            response.responseBody = mockResponse;
-            response.error = "";  // 没有错误
+void Client::sendByDDS(const FrameBatchWriter &batch) {
+    const std::vector<uint8_t> &frame = batch.bytes();
+#ifdef REGISTRYCPP_TRACE_DDS
+    std::cerr << "Sent By DDS, " << batch.messages() << " request(s), " << frame.size() << " bytes\n";
+#endif
 
-            request->complete(response);  // 完成请求，设置响应
-            // pending.erase 在removeRequest中处理
+    //TODO 接入DDS后发送frame，响应由DataReader回调发布到responseChannel
+    // 目前模拟对端：拆包解码后立即回复同一seq，响应同样合并成一帧；只在发送线程上调用，缓冲区跨帧复用
+    Request &received = peer.request;
+    Response &response = peer.response;
+    FrameBatchWriter &replies = peer.replies;
+    replies.clear();
+    forEachBatchedMessage(frame.data(), frame.size(), [&](const uint8_t *data, size_t size) {
+        if (!decodeRequest(data, size, received)) {
+            return;
+        }
+        uint32_t loss = peer.lossPerMillion.load(std::memory_order_relaxed);
+        if (loss > 0 && peer.rng() % 1000000 < loss) {
+            return;  // 模拟对端丢失或卡住的请求
         }
+        response.seq = received.header.seq;
+        response.status = Response::STATUS_SUCCESS;
+        response.error.clear();
+        if (received.header.methodId == MethodId::SetRadarStatus) {
+            fillMockReply<SetRadarStatusResponse>(response);
+        } else {
+            fillMockReply<GetRadarStatusResponse>(response);
+        }
+        encodeResponse(response, peer.message);
+        replies.append(peer.message);
+    });
+    if (!replies.empty()) {
+        responseChannel.publish(replies.bytes().data(), replies.bytes().size());
     }
 }
-
-void sendByDDS(const std::shared_ptr<Request> &request) {
-    //TODO
-    std::cout << "Sent By DDS" << std::endl;
-}
\ No newline at end of file
@@ -7,9 +7,30 @@
 
 
 #include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <condition_variable>
+#include <unordered_map>
+#include <array>
+#include <random>
 #include "../common/Args.h"
 #include "../common/Request.h"
+#include "../common/RpcMethods.h"
+#include "../common/MpscQueue.h"
+#include "../common/DdsChannel.h"
+#include "../common/FrameBatch.h"
+#include "../common/MethodStats.h"
+#include "PendingTable.h"
+#include "RequestPool.h"
+#include "TimerWheel.h"
+#include "EndpointCache.h"
+#include "InflightTracker.h"
+#include "Hedging.h"
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
 
 /**
  * 1. 服务消费者调用Client.Call("NodeName.ServiceName.ServiceName", body, &reply)进行远程调用
@@ -27,26 +48,273 @@
  * 3. 异步调用的支持，设置"pending" map 存储为处理完的请求
  */
 
+/**
+ * 异步调用
+ * 1. CallAsync(method, args, callback)：立即返回，响应在接收线程上回调；发送失败时在调用线程上立即回调
+ * 2. co_await client.CallAsync(method, args)：C++20协程，在接收线程上恢复执行
+ * 两者都不占用等待线程，同时在途的调用数只受pending表容量限制
+ */
+
+/**
+ * 请求合并
+ * 发送线程把队列里的请求编码后追加到同一个帧，满maxMessages/maxBytes立即发出
+ * 队列取空后：距上次发帧已超过maxDelay（链路空闲）则立即发出，否则最多再等maxDelay凑批
+ * 单次调用的额外延迟不超过maxDelay，BatchPolicy{1}即关闭合并
+ */
+
+/**
+ * 服务解析
+ * resolve先查本地缓存，未命中才通过resolver向registry发FindServiceRequest，成功结果按endpointTtl缓存
+ * registry的某个服务类型变化时调用onServiceChanged(类型)，只失效该类型的条目，稳态调用不再经过发现流程
+ * mode 2（负载均衡）每次都要重新抽样，不缓存；Call(endpoint, ...)发出的调用按实例计入在途数，上报给registry
+ * 设置了loadReporter时，mode 2的resolve在询问registry之前先上报在途数，间隔不小于LOAD_REPORT_INTERVAL
+ */
+
+/**
+ * 对冲请求
+ * 设置了HedgePolicy的方法，Call(endpoint, ...)在主调用的p95延迟内没有成功响应时，
+ * 通过resolve(policy.lookup，排除主实例)找到第二个实例再发一份，先到的成功响应生效，另一份从pending中撤销
+ * 计时线程只把到期的主调用seq交给对冲线程，resolve（可能同步询问registry）和发送都在对冲线程上进行
+ * 对冲线程在第一次setHedgePolicy时启动，对冲数量受全局令牌桶限制
+ */
+
+/**
+ * 调用对象复用
+ * Request和它的shared_ptr控制块来自RequestPool，调用结束后连同字符串容量一起回收
+ * 同步调用通过Request内嵌的Completion等待，不再为每次调用分配promise/future的共享状态
+ * 调用方复用reply（或类型化调用的RpcResult）时，稳态下一次同步调用没有堆分配
+ */
+
+/**
+ * 调用统计
+ * 每个方法在stats中记录排队（send到写入帧）、往返（写入帧到收到响应）、端到端（含超时）延迟和错误数
+ * 记录在完成调用的线程上进行，不加锁；通过methodStats()读取分位数，或startStatsDump定期输出
+ */
+
+/**
+ * 调用超时
+ * 每次调用都可以单独指定timeout，默认DEFAULT_CALL_TIMEOUT
+ * 发送时在客户端共享的时间轮上登记seq，到期后由计时线程从pending表取出并以STATUS_TIMEOUT完成
+ * 响应和超时通过pending.take竞争，只有一方能完成调用；超时精度为一个tick
+ */
+
 class Client {
 private:
-    uint64_t seq = 0;
-    std::mutex mtx;
+    std::atomic<uint64_t> seq{1};      // 0留给未注册的请求
     std::condition_variable cv;
     Response last_response;
     std::atomic<bool> closing{false};  // 客户端是否正在关闭
     std::atomic<bool> shutdown{false}; // 客户端是否已经关闭
-    std::map<uint64_t, std::shared_ptr<Request>> pending; // 存储所有待处理的调用
+    static constexpr size_t PENDING_CAPACITY = 4096;
+    PendingTable pending{PENDING_CAPACITY}; // 存储所有待处理的调用，按seq无锁存取
+    RequestPool requests{PENDING_CAPACITY};  // 空闲调用对象，最多保留与pending表容量相同的数量
+
+    // 发送线程：调用方只把请求放进无锁队列，由常驻的发送线程按batchPolicy合并成帧交给DDS
+    static constexpr size_t SEND_QUEUE_CAPACITY = 4096;
+    const BatchPolicy batchPolicy;
+    MpscQueue<std::shared_ptr<Request>> sendQueue{SEND_QUEUE_CAPACITY};
+    std::thread senderThread;
+    std::mutex senderMtx;
+    std::condition_variable senderCv;
+    std::atomic<bool> senderIdle{false};  // 发送线程即将或已经休眠，生产者需要唤醒它
+
+    // 接收线程阻塞在响应topic上，帧到达后立即解码、按seq取出调用并成批完成
+    DdsChannel responseChannel;
+    std::thread receiverThread;
+
+    // 模拟对端在发送线程上使用的缓冲区，接入DDS后删除
+    struct MockPeer {
+        Request request;
+        Response response;
+        FrameBatchWriter replies;
+        std::vector<uint8_t> message;
+        std::atomic<uint32_t> lossPerMillion{0};  // 不回复的请求比例，百万分之一
+        std::minstd_rand rng{12345};
+    } peer;
+
+    // 服务解析缓存，resolver只在未命中时调用
+    static constexpr std::chrono::milliseconds DEFAULT_ENDPOINT_TTL{30000};
+    EndpointCache endpoints{DEFAULT_ENDPOINT_TTL};
+    std::function<Response(const FindServiceRequest &)> resolver;
+    InflightTracker inflight;  // 按目标实例统计的在途调用，供registry做负载均衡
+    static constexpr std::chrono::milliseconds LOAD_REPORT_INTERVAL{20};
+    std::function<void(const std::vector<InstanceLoad> &)> loadReporter;
+    std::atomic<int64_t> lastLoadReport{0};  // steady_clock的tick，0表示还没有上报过
+    void reportLoad();
+
+    // 各方法请求头中的优先级，按MethodId下标存放，在发起调用前设置
+    std::array<Priority, static_cast<size_t>(MethodId::Count)> methodPriorities;
+
+    MethodStats stats;  // 计时线程和接收线程都会记录，必须在timeouts之前构造
+
+    // 对冲请求：策略按MethodId下标存放，在发起调用前设置；等待对冲的调用按主调用seq登记
+    struct HedgeSettings {
+        HedgePolicy policy;
+        LatencyWindow latency;  // 主调用的延迟
+    };
+    struct HedgedCall;
+    static constexpr double HEDGE_BUDGET_RATIO = 0.05;  // 对冲请求最多占可对冲调用的5%
+    static constexpr uint32_t HEDGE_BUDGET_BURST = 10;
+    std::array<std::unique_ptr<HedgeSettings>, static_cast<size_t>(MethodId::Count)> hedgePolicies;
+    HedgeBudget hedgeBudget{HEDGE_BUDGET_RATIO, HEDGE_BUDGET_BURST};
+    std::mutex hedgeMtx;
+    std::unordered_map<uint64_t, std::shared_ptr<HedgedCall>> hedgeWaiting;
+    std::vector<uint64_t> hedgeReady;  // 对冲定时器已到期的主调用seq，hedgeMtx保护
+    std::condition_variable hedgeCv;
+    bool hedgeStopping = false;
+    std::thread hedgeThread;
+
+    // 所有调用共享一个时间轮，不需要为每个调用阻塞一个线程等超时
+    // 到期回调会用到上面的成员，必须最后构造、最先析构
+    static constexpr std::chrono::milliseconds TIMER_TICK{10};
+    static constexpr size_t TIMER_SLOTS = 1024;  // 一圈约10秒，默认超时不需要绕圈
+    // 已完成调用的定时器也要等计时线程取走，登记队列按一个tick内的调用量而不是在途调用数估算
+    static constexpr size_t TIMER_QUEUE_CAPACITY = 65536;
+    // key的最高位区分对冲定时器和超时定时器，低位都是seq
+    static constexpr uint64_t HEDGE_TIMER = uint64_t(1) << 63;
+    TimerWheel timeouts{TIMER_TICK, TIMER_SLOTS, TIMER_QUEUE_CAPACITY,
+                        [this](uint64_t key) { onTimer(key); }};
+
+    HedgeSettings *hedgeSettingsFor(MethodId id) const;
+    void callHedged(HedgeSettings &settings, const std::shared_ptr<Request> &request, const Service &endpoint,
+                    ResponseCallback deliver, std::chrono::milliseconds timeout);
+    void fireHedge(uint64_t primarySeq);
+    void hedgeLoop();
+    void finishHedged(const std::shared_ptr<HedgedCall> &call, int which, const Response &response);
+    void onTimer(uint64_t key);
+    bool checkReply(const Response &reply);
+
+    // 从池中取出请求并写入方法和参数，赋值沿用上一次调用留下的容量；seq在registerRequest中分配
+    std::shared_ptr<Request> acquireRequest(const Service *endpoint);
+
+    template<typename Args>
+    std::shared_ptr<Request> makeRequest(const Service *endpoint, const std::string &method, const Args &args) {
+        auto request = acquireRequest(endpoint);
+        request->header.serviceMethod = method;
+        request->header.methodId = methodIdOf(method);
+        request->header.priority = methodPriorities[static_cast<size_t>(request->header.methodId)];
+        request->body.param = args;
+        return request;
+    }
+
+    template<typename Args>
+    std::shared_ptr<Request> makeRequest(const Service *endpoint, MethodId id, const Args &args) {
+        auto request = acquireRequest(endpoint);
+        request->header.serviceMethod.clear();
+        request->header.methodId = id;
+        request->header.priority = methodPriorities[static_cast<size_t>(id)];
+        request->body.param = args;
+        return request;
+    }
+
+    std::shared_ptr<Request> makeRequest(const Service *endpoint, const RequestHeader &header, const ArgVariant &args);
+
+    // 阻塞到调用完成，结果存放在request内，调用方持有request期间有效
+    const Response &callBlocking(const Service *endpoint, const std::shared_ptr<Request> &request,
+                                 std::chrono::milliseconds timeout);
+    void callAsync(const Service *endpoint, const std::shared_ptr<Request> &request, ResponseCallback callback,
+                   std::chrono::milliseconds timeout);
+    std::shared_ptr<Request> takePending(uint64_t req_seq);
 
     void receiveFromDDS();
+    void sendByDDS(const FrameBatchWriter &batch);
+    void senderLoop();
+    void wakeSender();
+    void expireRequest(uint64_t req_seq);
+    void recordFailure(const Request &request);
 //    void sendDDS(const Request& req);
 //    Response receiveResponse();
 
 public:
-    Client();
+    static constexpr std::chrono::milliseconds DEFAULT_CALL_TIMEOUT{6000};
+
+    explicit Client(BatchPolicy batchPolicy = BatchPolicy());
 
     ~Client();
 
-    bool Call(const std::string &method, const GetRadarStatusRequest &args, Response *reply);
+    bool Call(const std::string &method, const GetRadarStatusRequest &args, Response *reply,
+              std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT);
+
+    void CallAsync(const std::string &method, const GetRadarStatusRequest &args, ResponseCallback callback,
+                   std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT);
+
+    // 发往resolve得到的实例，调用期间计入该实例的在途调用数
+    bool Call(const Service &endpoint, const std::string &method, const GetRadarStatusRequest &args, Response *reply,
+              std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT);
+
+    void CallAsync(const Service &endpoint, const std::string &method, const GetRadarStatusRequest &args,
+                   ResponseCallback callback, std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT);
+
+#if defined(__cpp_impl_coroutine)
+    class CallAwaitable;
+
+    CallAwaitable CallAsync(const std::string &method, const GetRadarStatusRequest &args,
+                            std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT);
+#endif
+
+    // 设置向registry查询服务的方式，应在第一次resolve之前调用
+    void setResolver(std::function<Response(const FindServiceRequest &)> findService);
+
+    bool resolve(const FindServiceRequest &request, Service *endpoint);
+
+    // 设置上报在途调用数的方式，通常为registry.reportLoad(本客户端的id, loads)；应在第一次resolve之前调用
+    void setLoadReporter(std::function<void(const std::vector<InstanceLoad> &)> report);
+
+    // registry的服务类型变化通知，可在任意线程调用
+    void onServiceChanged(const std::string &serviceType);
+
+    // 类型化调用：M为RpcMethods.h中的方法描述，参数和返回类型在编译期确定
+    template<typename M>
+    RpcResult<typename M::ReplyType> call(const typename M::ArgsType &args,
+                                          std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT) {
+        RpcResult<typename M::ReplyType> result;
+        call<M>(args, result, timeout);
+        return result;
+    }
+
+    template<typename M>
+    RpcResult<typename M::ReplyType> call(const Service &endpoint, const typename M::ArgsType &args,
+                                          std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT) {
+        auto request = makeRequest(&endpoint, M::id, args);
+        return toRpcResult<typename M::ReplyType>(callBlocking(&endpoint, request, timeout));
+    }
+
+    // 结果写入调用方复用的result，循环调用时不再分配
+    template<typename M>
+    bool call(const typename M::ArgsType &args, RpcResult<typename M::ReplyType> &result,
+              std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT) {
+        auto request = makeRequest(nullptr, M::id, args);
+        toRpcResult(callBlocking(nullptr, request, timeout), result);
+        return result.ok();
+    }
+
+    // onReply(RpcResult<M::ReplyType>)，执行线程与CallAsync相同
+    template<typename M, typename Fn>
+    void callAsync(const typename M::ArgsType &args, Fn onReply,
+                   std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT) {
+        callAsync(nullptr, makeRequest(nullptr, M::id, args),
+                  [onReply = std::move(onReply)](const Response &r) {
+                      onReply(toRpcResult<typename M::ReplyType>(r));
+                  }, timeout);
+    }
+
+    // 为method开启对冲，只作用于Call(endpoint, ...)；应在发起调用前设置，未知方法返回false
+    bool setHedgePolicy(const std::string &method, HedgePolicy policy);
+
+    // method的请求在服务端按priority排队，setRadarStatus默认Priority::Critical，其余默认Priority::Normal
+    // 应在发起调用前设置，未知方法返回false
+    bool setMethodPriority(const std::string &method, Priority priority);
+
+    const MethodStats &methodStats() const { return stats; }
+
+    // 每隔interval把各方法的统计输出到std::cerr
+    void startStatsDump(std::chrono::milliseconds interval) { stats.startPeriodicDump(interval, std::cerr, "client"); }
+
+    // 模拟对端按rate随机不回复请求，这些调用只能超时或被对冲挽回；用于超时和对冲的测试，接入DDS后删除
+    void setMockLoss(double rate) { peer.lossPerMillion.store(static_cast<uint32_t>(rate * 1e6)); }
+
+    // 当前各实例的在途调用数，设置了loadReporter时由resolve定期上报
+    std::vector<InstanceLoad> inflightSnapshot() const;
 
     bool IsAvailable() const;
 
@@ -56,9 +324,42 @@ public:
 
     void terminateRequests(const std::string &err);
 
-    void send(const std::shared_ptr<Request> &call);
+    void send(const std::shared_ptr<Request> &call, std::chrono::milliseconds timeout = DEFAULT_CALL_TIMEOUT);
 
     void checkPendingRequests();
 };
 
+#if defined(__cpp_impl_coroutine)
+// 挂起时发出请求，响应到达后在接收线程上恢复协程，co_await的结果即为Response
+class Client::CallAwaitable {
+public:
+    CallAwaitable(Client &client, std::string method, GetRadarStatusRequest args, std::chrono::milliseconds timeout)
+            : client(client), method(std::move(method)), args(std::move(args)), timeout(timeout) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        // 回调可能在CallAsync返回之前就执行，此后不能再访问this
+        client.CallAsync(method, args, [this, handle](const Response &r) {
+            response = r;
+            handle.resume();
+        }, timeout);
+    }
+
+    Response await_resume() { return std::move(response); }
+
+private:
+    Client &client;
+    std::string method;
+    GetRadarStatusRequest args;
+    std::chrono::milliseconds timeout;
+    Response response;
+};
+
+inline Client::CallAwaitable Client::CallAsync(const std::string &method, const GetRadarStatusRequest &args,
+                                               std::chrono::milliseconds timeout) {
+    return CallAwaitable(*this, method, args, timeout);
+}
+#endif
+
 #endif //REGISTRYCPP_CLIENT_H
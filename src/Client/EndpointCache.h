@@ -0,0 +1,128 @@
+// EndpointCache.h
+
+#ifndef REGISTRYCPP_ENDPOINTCACHE_H
+#define REGISTRYCPP_ENDPOINTCACHE_H
+
+#include <map>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <string_view>
+#include <shared_mutex>
+#include "../common/Service.h"
+
+/**
+ * 客户端的服务解析缓存：(service_name, mode, exclude_instance) -> 上一次FindService返回的实例
+ * 按服务类型（service_name的第三段，即registry的键、Merkle树的叶子）分桶
+ * 1. 条目在ttl后过期，兜底处理丢失的变更通知
+ * 2. registry某个类型的叶子哈希变化时invalidate(类型)，整桶删除
+ * 3. 每个类型带一个代数，解析开始前取代数，解析期间发生过失效则不写回，避免旧结果覆盖通知
+ * mode 0按位置匹配，同一客户端的位置视为不变，因此不进入键
+ */
+class EndpointCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit EndpointCache(std::chrono::milliseconds ttl) : ttl(ttl) {}
+
+    bool lookup(const FindServiceRequest &request, Service &out) const {
+        const std::string &serviceName = request.service_name;
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        auto bucket = buckets.find(serviceTypeOf(serviceName));
+        if (bucket == buckets.end()) {
+            return false;
+        }
+        auto it = bucket->second.entries.find(
+                KeyView{serviceName, request.descriptor.mode, request.exclude_instance});
+        if (it == bucket->second.entries.end() || Clock::now() >= it->second.expires) {
+            return false;
+        }
+        out = it->second.endpoint;
+        return true;
+    }
+
+    // 开始解析前调用，结果交给store时一并传回
+    uint64_t generation(const std::string &serviceName) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        auto bucket = buckets.find(serviceTypeOf(serviceName));
+        return bucket == buckets.end() ? 0 : bucket->second.generation;
+    }
+
+    // 解析期间该类型已失效时丢弃结果，返回false
+    bool store(const FindServiceRequest &request, const Service &endpoint, uint64_t generation) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        Bucket &bucket = buckets[std::string(serviceTypeOf(request.service_name))];
+        if (bucket.generation != generation) {
+            return false;
+        }
+        Key key{request.service_name, request.descriptor.mode, request.exclude_instance};
+        bucket.entries[std::move(key)] = Entry{endpoint, Clock::now() + ttl};
+        return true;
+    }
+
+    void invalidate(std::string_view serviceType) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        auto bucket = buckets.find(serviceType);
+        if (bucket == buckets.end()) {
+            // 还没有缓存过也要留下代数，让正在进行的解析失效
+            buckets[std::string(serviceType)].generation = 1;
+            return;
+        }
+        bucket->second.entries.clear();
+        ++bucket->second.generation;
+    }
+
+    void clear() {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        for (auto &[type, bucket]: buckets) {
+            bucket.entries.clear();
+            ++bucket.generation;
+        }
+    }
+
+private:
+    struct Key {
+        std::string serviceName;
+        int mode;
+        std::string exclude;
+    };
+
+    struct KeyView {
+        std::string_view serviceName;
+        int mode;
+        std::string_view exclude;
+    };
+
+    // 透明比较，查找时不为键构造string
+    struct KeyLess {
+        using is_transparent = void;
+
+        template<typename A, typename B>
+        bool operator()(const A &a, const B &b) const {
+            if (a.mode != b.mode) {
+                return a.mode < b.mode;
+            }
+            int byName = std::string_view(a.serviceName).compare(b.serviceName);
+            if (byName != 0) {
+                return byName < 0;
+            }
+            return std::string_view(a.exclude) < std::string_view(b.exclude);
+        }
+    };
+
+    struct Entry {
+        Service endpoint;
+        Clock::time_point expires;
+    };
+
+    struct Bucket {
+        uint64_t generation = 0;
+        std::map<Key, Entry, KeyLess> entries;
+    };
+
+    const Clock::duration ttl;
+    mutable std::shared_mutex mtx;
+    std::map<std::string, Bucket, std::less<>> buckets;
+};
+
+#endif //REGISTRYCPP_ENDPOINTCACHE_H
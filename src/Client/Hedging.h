@@ -0,0 +1,100 @@
+// Hedging.h
+
+#ifndef REGISTRYCPP_HEDGING_H
+#define REGISTRYCPP_HEDGING_H
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "../common/Service.h"
+
+/**
+ * 对冲请求：主调用在该方法的p95延迟内没有响应时，向registry给出的第二个实例再发一份，先到的响应生效
+ * 只对设置了HedgePolicy的方法、且通过Call(endpoint, ...)发往具体实例的调用生效
+ */
+struct HedgePolicy {
+    FindServiceRequest lookup;                       // 选第二个实例时的查询，exclude_instance由客户端填写
+    double quantile = 0.95;                          // 按主调用延迟的该分位数决定何时对冲
+    std::chrono::milliseconds initialDelay{50};      // 样本不足时使用的对冲延迟
+    std::chrono::milliseconds minDelay{5};           // 对冲延迟下限，避免延迟很低时几乎每次都对冲
+};
+
+// 最近N次主调用的延迟，包括输给对冲、被撤销的主调用（按撤销时的耗时），分位数每攒够一批新样本才重新计算
+class LatencyWindow {
+public:
+    static constexpr size_t SIZE = 128;
+    static constexpr size_t MIN_SAMPLES = 20;
+
+    void record(std::chrono::microseconds latency) {
+        std::lock_guard<std::mutex> lock(mtx);
+        samples[next++ % SIZE] = latency.count();
+        if (next >= MIN_SAMPLES && next % RECOMPUTE_EVERY == 0) {
+            size_t count = std::min(next, SIZE);
+            std::array<int64_t, SIZE> sorted;
+            std::copy(samples.begin(), samples.begin() + count, sorted.begin());
+            auto rank = static_cast<size_t>(quantile * (count - 1));
+            std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + count);
+            cached.store(sorted[rank], std::memory_order_relaxed);
+        }
+    }
+
+    // 样本不足时返回fallback
+    std::chrono::microseconds percentile(std::chrono::microseconds fallback) const {
+        int64_t value = cached.load(std::memory_order_relaxed);
+        return value < 0 ? fallback : std::chrono::microseconds(value);
+    }
+
+    void setQuantile(double q) { quantile = q; }
+
+private:
+    static constexpr size_t RECOMPUTE_EVERY = 16;
+
+    std::mutex mtx;
+    std::array<int64_t, SIZE> samples{};
+    size_t next = 0;
+    double quantile = 0.95;
+    std::atomic<int64_t> cached{-1};
+};
+
+/**
+ * 全局对冲预算，令牌桶：每个可对冲的调用存入ratio个令牌，每次对冲消耗一个
+ * 对冲请求不超过可对冲调用数的ratio倍（外加burst），provider整体变慢时不会把负载放大一倍
+ */
+class HedgeBudget {
+public:
+    HedgeBudget(double ratio, uint32_t burst)
+            : perCall(static_cast<int64_t>(ratio * SCALE)), capacity(int64_t(burst) * SCALE), tokens(capacity) {}
+
+    void deposit() {
+        int64_t current = tokens.load(std::memory_order_relaxed);
+        while (current < capacity &&
+               !tokens.compare_exchange_weak(current, std::min(capacity, current + perCall),
+                                             std::memory_order_relaxed)) {
+        }
+    }
+
+    bool tryWithdraw() {
+        int64_t current = tokens.load(std::memory_order_relaxed);
+        while (current >= SCALE) {
+            if (tokens.compare_exchange_weak(current, current - SCALE, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void refund() { tokens.fetch_add(SCALE, std::memory_order_relaxed); }
+
+private:
+    static constexpr int64_t SCALE = 1000;  // 一次对冲的令牌数，ratio按千分之一精度
+
+    const int64_t perCall;
+    const int64_t capacity;
+    std::atomic<int64_t> tokens;
+};
+
+#endif //REGISTRYCPP_HEDGING_H
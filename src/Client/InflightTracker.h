@@ -0,0 +1,52 @@
+// InflightTracker.h
+
+#ifndef REGISTRYCPP_INFLIGHTTRACKER_H
+#define REGISTRYCPP_INFLIGHTTRACKER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+#include "../common/Service.h"
+
+/**
+ * 客户端对每个目标实例的在途调用计数，定期通过snapshot上报给registry做负载均衡
+ * 计数器创建后地址不变，请求直接持有指针，完成时无需再按实例名查找
+ * 实例数量有限，计数器只增不删
+ */
+class InflightTracker {
+public:
+    // 返回instance的计数器，第一次出现时创建
+    std::atomic<uint32_t> *counter(const std::string &instance) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mtx);
+            auto it = counters.find(instance);
+            if (it != counters.end()) {
+                return &it->second;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        return &counters.try_emplace(instance, 0u).first->second;
+    }
+
+    // 只包含当前仍有在途调用的实例
+    std::vector<InstanceLoad> snapshot() const {
+        std::vector<InstanceLoad> loads;
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        for (const auto &[instance, count]: counters) {
+            uint32_t value = count.load(std::memory_order_relaxed);
+            if (value > 0) {
+                loads.push_back(InstanceLoad{instance, value});
+            }
+        }
+        return loads;
+    }
+
+private:
+    mutable std::shared_mutex mtx;
+    std::unordered_map<std::string, std::atomic<uint32_t>> counters;
+};
+
+#endif //REGISTRYCPP_INFLIGHTTRACKER_H
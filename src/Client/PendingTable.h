@@ -0,0 +1,81 @@
+// PendingTable.h
+
+#ifndef REGISTRYCPP_PENDINGTABLE_H
+#define REGISTRYCPP_PENDINGTABLE_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "../common/Request.h"
+
+/**
+ * 待处理调用表：定长槽位数组，按 seq & mask 定位
+ * 槽位的state保存占用者的 seq + 1，高位即代数标签，旧调用的seq不会误命中新占用者
+ * state为0表示空闲，BUSY表示正在写入或取出
+ * 注册、取出都只有一次CAS，不加锁、不遍历，响应完成与超时谁先CAS成功谁拿到请求
+ */
+class PendingTable {
+public:
+    explicit PendingTable(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        mask = size - 1;
+        slots.reset(new Slot[size]);
+    }
+
+    // 槽位仍被capacity个seq之前的调用占用时返回false
+    bool insert(uint64_t seq, std::shared_ptr<Request> request) {
+        Slot &slot = slots[seq & mask];
+        uint64_t expected = FREE;
+        if (!slot.state.compare_exchange_strong(expected, BUSY, std::memory_order_acquire)) {
+            return false;
+        }
+        slot.request = std::move(request);
+        slot.state.store(seq + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 取出并释放seq对应的调用；已被取走、超时或seq过期时返回nullptr
+    std::shared_ptr<Request> take(uint64_t seq) {
+        Slot &slot = slots[seq & mask];
+        uint64_t expected = seq + 1;
+        if (!slot.state.compare_exchange_strong(expected, BUSY, std::memory_order_acquire)) {
+            return nullptr;
+        }
+        std::shared_ptr<Request> request = std::move(slot.request);
+        slot.state.store(FREE, std::memory_order_release);
+        return request;
+    }
+
+    bool contains(uint64_t seq) const {
+        return slots[seq & mask].state.load(std::memory_order_acquire) == seq + 1;
+    }
+
+    // 遍历当前占用的seq，仅用于诊断和关闭时清理，结果是近似快照
+    template<typename Fn>
+    void forEachSeq(Fn &&fn) const {
+        for (size_t i = 0; i <= mask; ++i) {
+            uint64_t state = slots[i].state.load(std::memory_order_acquire);
+            if (state != FREE && state != BUSY) {
+                fn(state - 1);
+            }
+        }
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    static constexpr uint64_t FREE = 0;
+    static constexpr uint64_t BUSY = UINT64_MAX;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> state{FREE};
+        std::shared_ptr<Request> request;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+};
+
+#endif //REGISTRYCPP_PENDINGTABLE_H
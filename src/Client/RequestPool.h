@@ -0,0 +1,142 @@
+// RequestPool.h
+
+#ifndef REGISTRYCPP_REQUESTPOOL_H
+#define REGISTRYCPP_REQUESTPOOL_H
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <new>
+#include "../common/Request.h"
+
+/**
+ * 调用对象池：Request和shared_ptr的控制块都在释放后回到空闲链表，下次acquire直接取出
+ * 1. 最后一个shared_ptr释放时不析构Request，只清掉回调和在途计数指针，字符串、参数、completion原样保留
+ * 2. 控制块通过BlockAllocator从定长块的空闲链表分配，大小在第一次分配时确定
+ * 3. 池的状态由每个控制块共同持有，池本身先于在途调用析构也是安全的
+ * 空闲对象超过maxIdle后按普通方式释放，稳态下每次调用不再有堆分配
+ */
+class RequestPool {
+public:
+    explicit RequestPool(size_t maxIdle) : state(std::make_shared<State>(maxIdle)) {}
+
+    // 取出的请求已清空seq、error和completion，方法和参数由调用方赋值覆盖
+    std::shared_ptr<Request> acquire() {
+        Request *request = state->takeRequest();
+        request->header.seq = 0;
+        request->header.error.clear();
+        request->completion.reset();
+        return std::shared_ptr<Request>(request, Recycler{state}, BlockAllocator<Request>(state));
+    }
+
+private:
+    struct State {
+        explicit State(size_t maxIdle) : maxIdle(maxIdle) {
+            idleRequests.reserve(maxIdle);
+            idleBlocks.reserve(maxIdle);
+        }
+
+        ~State() {
+            for (Request *request: idleRequests) {
+                delete request;
+            }
+            for (void *block: idleBlocks) {
+                ::operator delete(block);
+            }
+        }
+
+        Request *takeRequest() {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!idleRequests.empty()) {
+                    Request *request = idleRequests.back();
+                    idleRequests.pop_back();
+                    return request;
+                }
+            }
+            return new Request();
+        }
+
+        void putRequest(Request *request) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (idleRequests.size() < maxIdle) {
+                    idleRequests.push_back(request);
+                    return;
+                }
+            }
+            delete request;
+        }
+
+        void *takeBlock(size_t size) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (blockSize == 0) {
+                    blockSize = size;
+                }
+                if (size == blockSize && !idleBlocks.empty()) {
+                    void *block = idleBlocks.back();
+                    idleBlocks.pop_back();
+                    return block;
+                }
+            }
+            return ::operator new(size);
+        }
+
+        void putBlock(void *block, size_t size) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (size == blockSize && idleBlocks.size() < maxIdle) {
+                    idleBlocks.push_back(block);
+                    return;
+                }
+            }
+            ::operator delete(block);
+        }
+
+        const size_t maxIdle;
+        std::mutex mtx;
+        std::vector<Request *> idleRequests;
+        std::vector<void *> idleBlocks;
+        size_t blockSize = 0;
+    };
+
+    // shared_ptr的删除器：回调里可能捕获了别的对象，归还前释放
+    struct Recycler {
+        std::shared_ptr<State> state;
+
+        void operator()(Request *request) const {
+            request->callback = nullptr;
+            request->inflight = nullptr;
+            state->putRequest(request);
+        }
+    };
+
+    // 只用于分配shared_ptr的控制块
+    template<typename T>
+    struct BlockAllocator {
+        using value_type = T;
+
+        explicit BlockAllocator(std::shared_ptr<State> state) : state(std::move(state)) {}
+
+        template<typename U>
+        BlockAllocator(const BlockAllocator<U> &other) : state(other.state) {}
+
+        T *allocate(size_t n) { return static_cast<T *>(state->takeBlock(n * sizeof(T))); }
+
+        void deallocate(T *p, size_t n) { state->putBlock(p, n * sizeof(T)); }
+
+        template<typename U>
+        bool operator==(const BlockAllocator<U> &other) const { return state == other.state; }
+
+        template<typename U>
+        bool operator!=(const BlockAllocator<U> &other) const { return state != other.state; }
+
+        std::shared_ptr<State> state;
+    };
+
+    std::shared_ptr<State> state;
+};
+
+#endif //REGISTRYCPP_REQUESTPOOL_H
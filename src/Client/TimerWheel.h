@@ -0,0 +1,128 @@
+// TimerWheel.h
+
+#ifndef REGISTRYCPP_TIMERWHEEL_H
+#define REGISTRYCPP_TIMERWHEEL_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+#include "../common/MpscQueue.h"
+
+/**
+ * 哈希时间轮：slots个桶，每个tick推进一格，到期tick对桶数取模决定放在哪个桶
+ * 调用方线程只把(key, 到期tick)放进无锁队列，由计时线程每个tick取出挂到桶上，再扫描当前桶
+ * 登记和到期都是O(1)，超过一圈的定时器留在桶里等下一圈
+ * 不支持取消：调用先完成时定时器照常到期，由onExpire自己判断key是否还有效（PendingTable.take失败即可）
+ * onExpire在计时线程上执行，应当尽快返回
+ */
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimerWheel(std::chrono::milliseconds tick, size_t slots, size_t queueCapacity,
+               std::function<void(uint64_t)> onExpire)
+            : tick(tick), incoming(queueCapacity), onExpire(std::move(onExpire)), start(Clock::now()) {
+        size_t size = 2;
+        while (size < slots) size <<= 1;
+        mask = size - 1;
+        buckets.resize(size);
+        worker = std::thread(&TimerWheel::run, this);
+    }
+
+    TimerWheel(const TimerWheel &) = delete;
+
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    ~TimerWheel() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+
+    // 任意线程调用，不加锁；队列满时返回false
+    bool schedule(uint64_t key, std::chrono::milliseconds timeout) {
+        auto deadline = Clock::now() + timeout - start;
+        // 向上取整，保证不会早于timeout到期
+        auto ticks = static_cast<uint64_t>((deadline + tick - Clock::duration(1)) / tick);
+        return incoming.tryPush(Timer{key, ticks});
+    }
+
+    Clock::duration resolution() const { return tick; }
+
+private:
+    struct Timer {
+        uint64_t key = 0;
+        uint64_t expireTick = 0;
+    };
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (!stopping) {
+            auto next = start + tick * (currentTick + 1);
+            cv.wait_until(lock, next, [this]() { return stopping.load(); });
+            if (stopping) {
+                break;
+            }
+            lock.unlock();
+            advance(static_cast<uint64_t>((Clock::now() - start) / tick));
+            lock.lock();
+        }
+    }
+
+    void advance(uint64_t nowTick) {
+        Timer timer;
+        while (incoming.tryPop(timer)) {
+            if (timer.expireTick <= currentTick) {
+                onExpire(timer.key);  // 登记时已经到期
+            } else {
+                buckets[timer.expireTick & mask].push_back(timer);
+            }
+        }
+        // 线程被推迟时补走错过的每一格，落后超过一圈时每个桶只需扫一次
+        uint64_t last = nowTick - currentTick > mask ? currentTick + mask + 1 : nowTick;
+        while (currentTick < last) {
+            ++currentTick;
+            expireBucket(buckets[currentTick & mask], nowTick);
+        }
+        currentTick = nowTick;
+    }
+
+    void expireBucket(std::vector<Timer> &bucket, uint64_t nowTick) {
+        for (size_t i = 0; i < bucket.size();) {
+            if (bucket[i].expireTick <= nowTick) {
+                uint64_t key = bucket[i].key;
+                bucket[i] = bucket.back();  // 顺序无关，和末尾交换后删除
+                bucket.pop_back();
+                onExpire(key);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    const Clock::duration tick;
+    MpscQueue<Timer> incoming;
+    std::function<void(uint64_t)> onExpire;
+    const Clock::time_point start;
+
+    // 以下只由计时线程访问
+    std::vector<std::vector<Timer>> buckets;
+    size_t mask = 0;
+    uint64_t currentTick = 0;
+
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<bool> stopping{false};
+};
+
+#endif //REGISTRYCPP_TIMERWHEEL_H
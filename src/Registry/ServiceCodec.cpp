@@ -0,0 +1,593 @@
+// ServiceCodec.cpp
+
+#include "ServiceCodec.h"
+#include <unordered_map>
+#include <algorithm>
+#include "../common/Varint.h"
+
+namespace {
+
+void writeU32(uint8_t *out, uint32_t value) {
+    std::memcpy(out, &value, sizeof(value));
+}
+
+uint32_t readU32(const uint8_t *in) {
+    uint32_t value;
+    std::memcpy(&value, in, sizeof(value));
+    return value;
+}
+
+}
+
+// ----- Flat格式
+
+size_t flat_serialized_size(const std::vector<Service> &services) {
+    size_t size = FLAT_HEADER_SIZE + services.size() * sizeof(FlatServiceEntry);
+    for (const auto &service: services) {
+        size += service.service_name.size() + service.instance_id.size() + service.nodeId.size();
+    }
+    return size;
+}
+
+std::vector<uint8_t> serializeServicesFlat(const std::vector<Service> &services) {
+    std::vector<uint8_t> out;
+    serializeServicesFlat(services, out);
+    return out;
+}
+
+void serializeServicesFlat(const std::vector<Service> &services, std::vector<uint8_t> &out) {
+    // 先算出总大小，一次性分配整个缓冲区
+    size_t entriesSize = services.size() * sizeof(FlatServiceEntry);
+    size_t stringsSize = flat_serialized_size(services) - FLAT_HEADER_SIZE - entriesSize;
+    out.assign(FLAT_HEADER_SIZE + entriesSize + stringsSize, 0);
+
+    out[0] = static_cast<uint8_t>(ServiceWireFormat::Flat);
+    writeU32(&out[4], static_cast<uint32_t>(services.size()));
+    writeU32(&out[8], static_cast<uint32_t>(stringsSize));
+
+    uint8_t *entry = out.data() + FLAT_HEADER_SIZE;
+    uint8_t *strings = entry + entriesSize;
+    uint32_t cursor = 0;
+
+    auto put_string = [&](const std::string &str, uint32_t &offset, uint32_t &length) {
+        offset = cursor;
+        length = static_cast<uint32_t>(str.size());
+        std::memcpy(strings + cursor, str.data(), str.size());
+        cursor += length;
+    };
+
+    for (const auto &service: services) {
+        FlatServiceEntry e{};
+        put_string(service.service_name, e.nameOffset, e.nameLength);
+        put_string(service.instance_id, e.instanceOffset, e.instanceLength);
+        put_string(service.nodeId, e.nodeOffset, e.nodeLength);
+        e.is_alive = static_cast<uint8_t>(service.is_alive);
+        std::memcpy(entry, &e, sizeof(e));
+        entry += sizeof(e);
+    }
+}
+
+FlatServiceList::FlatServiceList(const uint8_t *data, size_t size) {
+    if (size < FLAT_HEADER_SIZE || data[0] != static_cast<uint8_t>(ServiceWireFormat::Flat)) {
+        return;
+    }
+
+    uint64_t num = readU32(data + 4);
+    uint64_t stringsSize = readU32(data + 8);
+    // 用64位计算，避免恶意的count导致溢出
+    if (FLAT_HEADER_SIZE + num * sizeof(FlatServiceEntry) + stringsSize != size) {
+        return;
+    }
+
+    const uint8_t *table = data + FLAT_HEADER_SIZE;
+    for (uint64_t i = 0; i < num; ++i) {
+        FlatServiceEntry e{};
+        std::memcpy(&e, table + i * sizeof(FlatServiceEntry), sizeof(e));
+        if (uint64_t(e.nameOffset) + e.nameLength > stringsSize ||
+            uint64_t(e.instanceOffset) + e.instanceLength > stringsSize ||
+            uint64_t(e.nodeOffset) + e.nodeLength > stringsSize) {
+            return;
+        }
+    }
+
+    entries = table;
+    strings = reinterpret_cast<const char *>(table + num * sizeof(FlatServiceEntry));
+    count = static_cast<uint32_t>(num);
+    isValid = true;
+}
+
+ServiceView FlatServiceList::operator[](uint32_t index) const {
+    FlatServiceEntry e{};
+    std::memcpy(&e, entries + size_t(index) * sizeof(FlatServiceEntry), sizeof(e));
+    return ServiceView{
+            std::string_view(strings + e.nameOffset, e.nameLength),
+            std::string_view(strings + e.instanceOffset, e.instanceLength),
+            std::string_view(strings + e.nodeOffset, e.nodeLength),
+            e.is_alive != 0
+    };
+}
+
+// ----- Compact格式
+
+bool parseUuid(std::string_view text, uint8_t out[16]) {
+    if (text.size() != 36) {
+        return false;
+    }
+
+    auto hex = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;  // 大写或其他字符按普通字符串处理，保证解码后原样还原
+    };
+
+    size_t byte = 0;
+    for (size_t i = 0; i < text.size();) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (text[i] != '-') return false;
+            ++i;
+            continue;
+        }
+        int high = hex(text[i]);
+        int low = hex(text[i + 1]);
+        if (high < 0 || low < 0) return false;
+        out[byte++] = static_cast<uint8_t>(high << 4 | low);
+        i += 2;
+    }
+    return true;
+}
+
+void formatUuid(const uint8_t in[16], char out[36]) {
+    static const char digits[] = "0123456789abcdef";
+    size_t pos = 0;
+    for (size_t byte = 0; byte < 16; ++byte) {
+        if (byte == 4 || byte == 6 || byte == 8 || byte == 10) {
+            out[pos++] = '-';
+        }
+        out[pos++] = digits[in[byte] >> 4];
+        out[pos++] = digits[in[byte] & 0x0F];
+    }
+}
+
+std::vector<uint8_t> serializeServicesCompact(const std::vector<Service> &services) {
+    // 按首次出现的顺序建立字典
+    std::unordered_map<std::string_view, uint32_t> nameIndex;
+    std::unordered_map<std::string_view, uint32_t> nodeIndex;
+    std::vector<std::string_view> names;
+    std::vector<std::string_view> nodes;
+
+    auto intern = [](std::unordered_map<std::string_view, uint32_t> &index, std::vector<std::string_view> &dict,
+                     const std::string &str) {
+        auto result = index.emplace(str, static_cast<uint32_t>(dict.size()));
+        if (result.second) {
+            dict.push_back(str);
+        }
+        return result.first->second;
+    };
+
+    std::vector<std::pair<uint32_t, uint32_t>> refs;
+    refs.reserve(services.size());
+    for (const auto &service: services) {
+        refs.emplace_back(intern(nameIndex, names, service.service_name), intern(nodeIndex, nodes, service.nodeId));
+    }
+
+    size_t bitmapSize = (services.size() + 7) / 8;
+    std::vector<uint8_t> out;
+    out.reserve(1 + 10 + 2 * bitmapSize + services.size() * 20);
+
+    out.push_back(static_cast<uint8_t>(ServiceWireFormat::Compact));
+    writeVarint(out, services.size());
+
+    for (const auto *dict: {&names, &nodes}) {
+        writeVarint(out, dict->size());
+        for (std::string_view str: *dict) {
+            writeVarint(out, str.size());
+            out.insert(out.end(), str.begin(), str.end());
+        }
+    }
+
+    size_t aliveAt = out.size();
+    size_t uuidAt = aliveAt + bitmapSize;
+    out.resize(uuidAt + bitmapSize, 0);
+
+    uint8_t uuid[16];
+    for (size_t i = 0; i < services.size(); ++i) {
+        const Service &service = services[i];
+        if (service.is_alive) {
+            out[aliveAt + i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+        }
+
+        writeVarint(out, refs[i].first);
+        writeVarint(out, refs[i].second);
+
+        if (parseUuid(service.instance_id, uuid)) {
+            out[uuidAt + i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+            out.insert(out.end(), uuid, uuid + sizeof(uuid));
+        } else {
+            writeVarint(out, service.instance_id.size());
+            out.insert(out.end(), service.instance_id.begin(), service.instance_id.end());
+        }
+    }
+
+    return out;
+}
+
+namespace {
+
+bool readString(const uint8_t *&cursor, const uint8_t *end, std::string_view &str) {
+    uint64_t length;
+    if (!readVarint(cursor, end, length) || length > uint64_t(end - cursor)) {
+        return false;
+    }
+    str = std::string_view(reinterpret_cast<const char *>(cursor), length);
+    cursor += length;
+    return true;
+}
+
+bool readDictionary(const uint8_t *&cursor, const uint8_t *end, std::vector<std::string_view> &dict) {
+    uint64_t size;
+    // 每项至少占1字节，据此拒绝伪造的超大字典
+    if (!readVarint(cursor, end, size) || size > uint64_t(end - cursor)) {
+        return false;
+    }
+    dict.resize(size);
+    for (auto &str: dict) {
+        if (!readString(cursor, end, str)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+CompactServiceReader::CompactServiceReader(const uint8_t *data, size_t size) : end(data + size) {
+    if (size == 0 || data[0] != static_cast<uint8_t>(ServiceWireFormat::Compact)) {
+        return;
+    }
+    cursor = data + 1;
+
+    // 每条记录至少占3字节（两个下标 + instance_id长度）
+    if (!readVarint(cursor, end, count) || count > uint64_t(end - cursor) / 3) {
+        return;
+    }
+    if (!readDictionary(cursor, end, names) || !readDictionary(cursor, end, nodes)) {
+        return;
+    }
+
+    uint64_t bitmapSize = (count + 7) / 8;
+    if (2 * bitmapSize > uint64_t(end - cursor)) {
+        return;
+    }
+    aliveBits = cursor;
+    uuidBits = cursor + bitmapSize;
+    cursor += 2 * bitmapSize;
+    isValid = true;
+}
+
+bool CompactServiceReader::next(ServiceView &view) {
+    if (!isValid) {
+        return false;
+    }
+    if (index == count) {
+        // 最后一条记录之后不允许有多余字节，与Flat、Legacy格式一致
+        isValid = cursor == end;
+        return false;
+    }
+
+    uint64_t nameRef, nodeRef;
+    if (!readVarint(cursor, end, nameRef) || nameRef >= names.size() ||
+        !readVarint(cursor, end, nodeRef) || nodeRef >= nodes.size()) {
+        isValid = false;
+        return false;
+    }
+
+    uint8_t mask = static_cast<uint8_t>(1u << (index % 8));
+    if (uuidBits[index / 8] & mask) {
+        if (end - cursor < 16) {
+            isValid = false;
+            return false;
+        }
+        formatUuid(cursor, uuidText);
+        cursor += 16;
+        view.instance_id = std::string_view(uuidText, sizeof(uuidText));
+    } else if (!readString(cursor, end, view.instance_id)) {
+        isValid = false;
+        return false;
+    }
+
+    view.service_name = names[nameRef];
+    view.nodeId = nodes[nodeRef];
+    view.is_alive = (aliveBits[index / 8] & mask) != 0;
+    ++index;
+    return true;
+}
+
+// ----- LivenessDelta
+
+uint64_t layoutHashStep(uint64_t hash, std::string_view serviceName, std::string_view instanceId) {
+    auto mix = [&hash](std::string_view str) {
+        for (char c: str) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xFF;  // 字段分隔，避免"ab"+"c"与"a"+"bc"冲突
+        hash *= 1099511628211ull;
+    };
+    mix(serviceName);
+    mix(instanceId);
+    return hash;
+}
+
+std::vector<uint8_t> serializeLivenessDelta(std::string_view nodeId, uint64_t version, uint64_t layoutHash,
+                                            uint32_t slotCount, const std::vector<LivenessChange> &changes) {
+    // 统计游程，和位图比较大小
+    size_t runCount = 0;
+    size_t runBytes = 0;
+    for (size_t i = 0, prevEnd = 0; i < changes.size();) {
+        size_t j = i + 1;
+        while (j < changes.size() && changes[j].slot == changes[j - 1].slot + 1) ++j;
+        runBytes += varintSize(changes[i].slot - prevEnd) + varintSize(j - i);
+        prevEnd = changes[j - 1].slot + 1;
+        ++runCount;
+        i = j;
+    }
+    runBytes += varintSize(runCount);
+    size_t bitmapBytes = (size_t(slotCount) + 7) / 8;
+    bool useRuns = runBytes < bitmapBytes;
+
+    std::vector<uint8_t> out;
+    out.reserve(1 + 5 + nodeId.size() + 10 + 8 + 10 + 5 + 1 + std::min(runBytes, bitmapBytes) + (changes.size() + 7) / 8);
+
+    out.push_back(static_cast<uint8_t>(ServiceWireFormat::LivenessDelta));
+    writeVarint(out, nodeId.size());
+    out.insert(out.end(), nodeId.begin(), nodeId.end());
+    writeVarint(out, version);
+    out.resize(out.size() + sizeof(layoutHash));
+    std::memcpy(out.data() + out.size() - sizeof(layoutHash), &layoutHash, sizeof(layoutHash));
+    writeVarint(out, slotCount);
+    writeVarint(out, changes.size());
+    out.push_back(useRuns ? 1 : 0);
+
+    if (useRuns) {
+        writeVarint(out, runCount);
+        for (size_t i = 0, prevEnd = 0; i < changes.size();) {
+            size_t j = i + 1;
+            while (j < changes.size() && changes[j].slot == changes[j - 1].slot + 1) ++j;
+            writeVarint(out, changes[i].slot - prevEnd);
+            writeVarint(out, j - i);
+            prevEnd = changes[j - 1].slot + 1;
+            i = j;
+        }
+    } else {
+        size_t at = out.size();
+        out.resize(at + bitmapBytes, 0);
+        for (const auto &change: changes) {
+            out[at + change.slot / 8] |= static_cast<uint8_t>(1u << (change.slot % 8));
+        }
+    }
+
+    size_t at = out.size();
+    out.resize(at + (changes.size() + 7) / 8, 0);
+    for (size_t i = 0; i < changes.size(); ++i) {
+        if (changes[i].is_alive) {
+            out[at + i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+        }
+    }
+
+    return out;
+}
+
+LivenessDeltaReader::LivenessDeltaReader(const uint8_t *data, size_t size) : end(data + size) {
+    if (size == 0 || data[0] != static_cast<uint8_t>(ServiceWireFormat::LivenessDelta)) {
+        return;
+    }
+    cursor = data + 1;
+
+    uint64_t nodeLength;
+    if (!readVarint(cursor, end, nodeLength) || nodeLength > uint64_t(end - cursor)) {
+        return;
+    }
+    node = std::string_view(reinterpret_cast<const char *>(cursor), nodeLength);
+    cursor += nodeLength;
+
+    if (!readVarint(cursor, end, deltaVersion) || end - cursor < 8) {
+        return;
+    }
+    std::memcpy(&hash, cursor, sizeof(hash));
+    cursor += sizeof(hash);
+
+    if (!readVarint(cursor, end, slots) || slots > UINT32_MAX ||
+        !readVarint(cursor, end, changes) || changes > slots || cursor == end) {
+        return;
+    }
+    encoding = *cursor++;
+
+    // 在这里校验整个载荷，next()给出的槽位因此都小于slotCount、个数正好是changeCount
+    // 接收端可以先确认有效再应用，不会只应用一半
+    const uint8_t *slotData = cursor;
+    if (encoding == 0) {
+        uint64_t bitmapBytes = (slots + 7) / 8;
+        if (bitmapBytes > uint64_t(end - cursor)) return;
+        uint64_t setBits = 0;
+        for (uint64_t i = 0; i < bitmapBytes; ++i) {
+            setBits += static_cast<uint64_t>(__builtin_popcount(cursor[i]));
+        }
+        // 置位数必须等于changeCount，最后一个字节中slotCount之后的填充位必须为0
+        if (setBits != changes || (slots % 8 != 0 && (cursor[bitmapBytes - 1] >> (slots % 8)) != 0)) return;
+        cursor += bitmapBytes;
+    } else if (encoding == 1) {
+        // 游程长度不定，先走一遍整个游程列表以定位新状态位图，同时检查范围和长度合计
+        uint64_t runCount, gap, length;
+        uint64_t position = 0, total = 0;
+        if (!readVarint(cursor, end, runCount) || runCount > changes) return;
+        for (uint64_t i = 0; i < runCount; ++i) {
+            if (!readVarint(cursor, end, gap) || !readVarint(cursor, end, length) || length == 0) return;
+            if (gap > slots - position || length > slots - position - gap) return;
+            position += gap + length;
+            total += length;
+        }
+        if (total != changes) return;
+    } else {
+        return;
+    }
+
+    // 新状态位图之后不允许有多余字节
+    if ((changes + 7) / 8 != uint64_t(end - cursor)) {
+        return;
+    }
+    values = cursor;
+    cursor = slotData;
+    if (encoding == 1) {
+        readVarint(cursor, end, runsLeft);
+    }
+    isValid = true;
+}
+
+bool LivenessDeltaReader::nextSlot(uint64_t &slot) {
+    if (encoding == 0) {
+        // 按字节跳过全0的部分，只检查有变化的位
+        while (scan < slots) {
+            uint8_t byte = cursor[scan / 8] >> (scan % 8);
+            if (byte == 0) {
+                scan = (scan / 8 + 1) * 8;
+                continue;
+            }
+            while (!(byte & 1)) {
+                byte >>= 1;
+                ++scan;
+            }
+            slot = scan++;
+            return slot < slots;
+        }
+        return false;
+    }
+
+    if (runRemaining == 0) {
+        uint64_t gap;
+        if (runsLeft == 0 || !readVarint(cursor, end, gap) || !readVarint(cursor, end, runRemaining) ||
+            runRemaining == 0) {
+            return false;
+        }
+        --runsLeft;
+        runNext += gap;
+    }
+    --runRemaining;
+    slot = runNext++;
+    return slot < slots;
+}
+
+bool LivenessDeltaReader::next(LivenessChange &change) {
+    if (!isValid || index == changes) {
+        return false;
+    }
+
+    uint64_t slot;
+    if (!nextSlot(slot)) {
+        isValid = false;
+        return false;
+    }
+
+    change.slot = static_cast<uint32_t>(slot);
+    change.is_alive = (values[index / 8] >> (index % 8)) & 1;
+    ++index;
+    return true;
+}
+
+// ----- 旧格式
+
+size_t serialized_size(const std::vector<Service> &services) {
+    size_t size = sizeof(uint32_t);
+    for (const auto &service: services) {
+        size += service.serialized_size();
+    }
+    return size;
+}
+
+size_t serialize_services_into(const std::vector<Service> &services, uint8_t *out, size_t capacity) {
+    size_t size = serialized_size(services);
+    if (size > capacity) {
+        return 0;
+    }
+
+    // 序列化服务数量
+    writeU32(out, static_cast<uint32_t>(services.size()));
+    uint8_t *cursor = out + sizeof(uint32_t);
+
+    for (const auto &service: services) {
+        cursor = service.serialize_to(cursor);
+    }
+
+    return size;
+}
+
+std::vector<uint8_t> serialize_services(const std::vector<Service> &services) {
+    std::vector<uint8_t> result;
+    serialize_services(services, result);
+    return result;
+}
+
+void serialize_services(const std::vector<Service> &services, std::vector<uint8_t> &arena) {
+    // 第一遍计算精确长度，第二遍直接写入，不会发生扩容
+    arena.resize(serialized_size(services));
+    serialize_services_into(services, arena.data(), arena.size());
+}
+
+void gather_services(const std::vector<Service> &services, std::vector<uint8_t> &scratch,
+                     std::vector<ServiceIoSegment> &segments) {
+    // 每条记录的定长部分：3个长度 + is_alive
+    scratch.resize(sizeof(uint32_t) + services.size() * (3 * sizeof(uint32_t) + sizeof(uint8_t)));
+    segments.clear();
+    segments.reserve(1 + services.size() * 6);
+
+    uint8_t *cursor = scratch.data();
+    const uint8_t *pending = cursor;  // 尚未加入segments的定长字段起点
+
+    auto flush_fixed = [&]() {
+        if (cursor != pending) {
+            segments.push_back({pending, static_cast<size_t>(cursor - pending)});
+            pending = cursor;
+        }
+    };
+
+    auto put_string = [&](const std::string &str) {
+        writeU32(cursor, static_cast<uint32_t>(str.size()));
+        cursor += sizeof(uint32_t);
+        if (!str.empty()) {
+            flush_fixed();
+            segments.push_back({reinterpret_cast<const uint8_t *>(str.data()), str.size()});
+        }
+    };
+
+    writeU32(cursor, static_cast<uint32_t>(services.size()));
+    cursor += sizeof(uint32_t);
+
+    for (const auto &service: services) {
+        put_string(service.service_name);
+        put_string(service.instance_id);
+        put_string(service.nodeId);
+        *cursor++ = static_cast<uint8_t>(service.is_alive);
+    }
+    flush_fixed();
+}
+
+// 反序列化 std::vector<Service>
+bool deserialize_services(const uint8_t *data, size_t size, std::vector<Service> &out) {
+    out.clear();
+    if (size >= sizeof(uint32_t)) {
+        uint32_t num_services;
+        std::memcpy(&num_services, data, sizeof(num_services));
+        // 预留的容量不超过数据实际能容纳的记录数
+        out.reserve(std::min<size_t>(num_services, (size - sizeof(uint32_t)) / (3 * sizeof(uint32_t) + 1)));
+    }
+    return for_each_service_checked(data, size, [&out](const ServiceView &service) {
+        out.push_back(service.toService());
+    });
+}
+
+std::vector<Service> deserialize_services(const std::vector<uint8_t> &data) {
+    std::vector<Service> services;
+    if (!deserialize_services(data.data(), data.size(), services)) {
+        services.clear();
+    }
+    return services;
+}
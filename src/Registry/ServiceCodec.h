@@ -0,0 +1,312 @@
+// ServiceCodec.h
+
+#ifndef REGISTRYCPP_SERVICECODEC_H
+#define REGISTRYCPP_SERVICECODEC_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include "../common/Service.h"
+
+/// description
+/// 编队间同步服务列表所用的编码格式
+/// 1. 旧格式：serialize_services / deserialize_services，逐条写入长度+字符串
+///    serialized_size先算出精确长度，再一次性写入预分配的缓冲区、调用方提供的缓冲区或分散/聚集段
+/// 2. Flat格式：定长偏移表 + 字符串区，接收端通过ServiceView直接访问缓冲区，解码不分配内存
+/// 3. Compact格式：消息内字典 + varint + 位图，用于编队间的低带宽链路，接收端流式解码
+/// 4. LivenessDelta：只有is_alive变化时，按槽位号发送变化的实例及其新状态，不再重发整条记录
+
+// 同步消息的首字节，用于区分编码格式
+enum class ServiceWireFormat : uint8_t {
+    Flat = 0x01,
+    Compact = 0x02,
+    LivenessDelta = 0x03
+};
+
+/**
+ * Flat格式布局（小端）
+ * [0]      uint8   format = ServiceWireFormat::Flat
+ * [1..3]   保留
+ * [4]      uint32  count        记录条数
+ * [8]      uint32  stringsSize  字符串区字节数
+ * [12]     count * FlatServiceEntry
+ * [...]    字符串区，FlatServiceEntry中的偏移相对于字符串区起始位置
+ */
+struct FlatServiceEntry {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t instanceOffset;
+    uint32_t instanceLength;
+    uint32_t nodeOffset;
+    uint32_t nodeLength;
+    uint8_t is_alive;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(FlatServiceEntry) == 28, "FlatServiceEntry must stay packed for the wire format");
+
+constexpr size_t FLAT_HEADER_SIZE = 12;
+
+size_t flat_serialized_size(const std::vector<Service> &services);
+
+std::vector<uint8_t> serializeServicesFlat(const std::vector<Service> &services);
+
+// 写入调用方提供的缓冲区，保留其容量以便重复使用
+void serializeServicesFlat(const std::vector<Service> &services, std::vector<uint8_t> &arena);
+
+/**
+ * Flat格式的访问器，构造时完成一次边界校验，之后按下标O(1)取得ServiceView
+ * 不持有缓冲区，调用方需保证缓冲区在访问期间有效
+ */
+class FlatServiceList {
+public:
+    class iterator {
+    public:
+        iterator(const FlatServiceList *list, uint32_t index) : list(list), index(index) {}
+
+        ServiceView operator*() const { return (*list)[index]; }
+
+        iterator &operator++() {
+            ++index;
+            return *this;
+        }
+
+        bool operator!=(const iterator &other) const { return index != other.index; }
+
+    private:
+        const FlatServiceList *list;
+        uint32_t index;
+    };
+
+    FlatServiceList(const uint8_t *data, size_t size);
+
+    explicit FlatServiceList(const std::vector<uint8_t> &buffer) : FlatServiceList(buffer.data(), buffer.size()) {}
+
+    bool valid() const { return isValid; }
+
+    uint32_t size() const { return count; }
+
+    ServiceView operator[](uint32_t index) const;
+
+    iterator begin() const { return {this, 0}; }
+
+    iterator end() const { return {this, count}; }
+
+private:
+    const uint8_t *entries = nullptr;
+    const char *strings = nullptr;
+    uint32_t count = 0;
+    bool isValid = false;
+};
+
+/**
+ * Compact格式布局
+ * uint8    format = ServiceWireFormat::Compact
+ * varint   count
+ * varint   服务名字典大小，随后每项为 varint长度 + 字节
+ * varint   节点字典大小，随后每项为 varint长度 + 字节
+ * bitmap   is_alive，ceil(count / 8)字节，第i条记录对应第i位
+ * bitmap   instance_id是否为二进制UUID，ceil(count / 8)字节
+ * 记录     varint服务名下标 + varint节点下标 + instance_id
+ *          instance_id为UUID时写16字节，否则写 varint长度 + 字节
+ */
+std::vector<uint8_t> serializeServicesCompact(const std::vector<Service> &services);
+
+/**
+ * Compact格式的流式读取器，每次next()解出一条记录
+ * 服务名和节点指向缓冲区内的字典；UUID形式的instance_id格式化到读取器内部，
+ * 因此视图只在下一次next()之前有效
+ */
+class CompactServiceReader {
+public:
+    CompactServiceReader(const uint8_t *data, size_t size);
+
+    explicit CompactServiceReader(const std::vector<uint8_t> &buffer)
+            : CompactServiceReader(buffer.data(), buffer.size()) {}
+
+    bool valid() const { return isValid; }
+
+    uint64_t size() const { return count; }
+
+    // 读到末尾或数据损坏时返回false，之后用valid()区分两种情况；最后一条记录之后有多余字节按损坏处理
+    bool next(ServiceView &view);
+
+private:
+    const uint8_t *cursor = nullptr;
+    const uint8_t *end = nullptr;
+    const uint8_t *aliveBits = nullptr;
+    const uint8_t *uuidBits = nullptr;
+    std::vector<std::string_view> names;
+    std::vector<std::string_view> nodes;
+    uint64_t count = 0;
+    uint64_t index = 0;
+    bool isValid = false;
+    char uuidText[36]{};
+};
+
+// instance_id是规范的小写UUID时转成16字节，否则返回false
+bool parseUuid(std::string_view text, uint8_t out[16]);
+
+void formatUuid(const uint8_t in[16], char out[36]);
+
+/**
+ * 槽位：某个节点自己的服务按registry的遍历顺序（服务类型字典序，类型内按列表顺序）依次编号
+ * 收发双方对同一节点的槽位布局用layoutHash校验，布局不一致时接收端丢弃delta，等待全量同步
+ */
+constexpr uint64_t LAYOUT_HASH_SEED = 14695981039346656037ull;
+
+// FNV-1a，按槽位顺序把(service_name, instance_id)依次累加进hash
+uint64_t layoutHashStep(uint64_t hash, std::string_view serviceName, std::string_view instanceId);
+
+/**
+ * LivenessDelta格式布局
+ * uint8    format = ServiceWireFormat::LivenessDelta
+ * varint   节点ID长度 + 字节
+ * varint   version      发送方单调递增的版本号，接收端丢弃不比已应用版本新的消息
+ * uint64   layoutHash
+ * varint   slotCount    发送方槽位总数
+ * varint   changeCount  变化的槽位数
+ * uint8    槽位编码：0 = slotCount位的位图；1 = 游程列表 varint runCount + (varint间隔, varint长度)*
+ * bitmap   变化槽位的新is_alive，按槽位升序，ceil(changeCount / 8)字节
+ * 发送时在位图和游程之间选较短的一种
+ */
+struct LivenessChange {
+    uint32_t slot;
+    bool is_alive;
+};
+
+// changes必须按slot升序且不重复
+std::vector<uint8_t> serializeLivenessDelta(std::string_view nodeId, uint64_t version, uint64_t layoutHash,
+                                            uint32_t slotCount, const std::vector<LivenessChange> &changes);
+
+// LivenessDelta的流式读取器，逐个给出变化的槽位，不分配内存
+class LivenessDeltaReader {
+public:
+    LivenessDeltaReader(const uint8_t *data, size_t size);
+
+    explicit LivenessDeltaReader(const std::vector<uint8_t> &buffer)
+            : LivenessDeltaReader(buffer.data(), buffer.size()) {}
+
+    bool valid() const { return isValid; }
+
+    std::string_view nodeId() const { return node; }
+
+    uint64_t version() const { return deltaVersion; }
+
+    uint64_t layoutHash() const { return hash; }
+
+    uint64_t slotCount() const { return slots; }
+
+    uint64_t changeCount() const { return changes; }
+
+    // 构造时已校验整个载荷：槽位都小于slotCount、个数等于changeCount、新状态位图之后没有多余字节
+    // 读到末尾或数据损坏时返回false，之后用valid()区分两种情况
+    bool next(LivenessChange &change);
+
+private:
+    bool nextSlot(uint64_t &slot);
+
+    const uint8_t *cursor = nullptr;
+    const uint8_t *end = nullptr;
+    const uint8_t *values = nullptr;
+    std::string_view node;
+    uint64_t deltaVersion = 0;
+    uint64_t hash = 0;
+    uint64_t slots = 0;
+    uint64_t changes = 0;
+    uint64_t index = 0;
+    uint8_t encoding = 0;
+    uint64_t scan = 0;       // 位图：下一个待检查的槽位
+    uint64_t runRemaining = 0;  // 游程：当前游程剩余的槽位数
+    uint64_t runsLeft = 0;
+    uint64_t runNext = 0;
+    bool isValid = false;
+};
+
+// 分散/聚集输出的一段，与iovec的布局一致，交给传输层一次性发送
+struct ServiceIoSegment {
+    const uint8_t *data;
+    size_t length;
+};
+
+// 旧格式
+size_t serialized_size(const std::vector<Service> &services);
+
+// 写入至少serialized_size字节的缓冲区，返回写入的字节数；容量不足时不写入并返回0
+size_t serialize_services_into(const std::vector<Service> &services, uint8_t *out, size_t capacity);
+
+std::vector<uint8_t> serialize_services(const std::vector<Service> &services);
+
+void serialize_services(const std::vector<Service> &services, std::vector<uint8_t> &arena);
+
+/**
+ * 不拷贝字符串的分散/聚集输出：长度、is_alive等定长字段写入scratch，
+ * 字符串段直接指向services中的数据。segments按顺序拼接即为serialize_services的结果，
+ * 在发送完成前services和scratch都不能被修改
+ */
+void gather_services(const std::vector<Service> &services, std::vector<uint8_t> &scratch,
+                     std::vector<ServiceIoSegment> &segments);
+
+/**
+ * 校验式解码，用于来自其他编队的不可信数据
+ * 所有长度在读取前都与剩余字节数比较；数据损坏时返回false，不会越界读，也不会按线上的数量预分配
+ * 每条记录回调一次ServiceView，视图指向data，本身不分配内存
+ */
+template<typename Fn>
+bool for_each_service_checked(const uint8_t *data, size_t size, Fn &&fn);
+
+// 数据损坏时返回false，out中只保留校验通过前已解出的记录
+bool deserialize_services(const uint8_t *data, size_t size, std::vector<Service> &out);
+
+// 数据损坏时返回空列表
+std::vector<Service> deserialize_services(const std::vector<uint8_t> &data);
+
+template<typename Fn>
+bool for_each_service_checked(const uint8_t *data, size_t size, Fn &&fn) {
+    constexpr size_t MIN_RECORD = 3 * sizeof(uint32_t) + sizeof(uint8_t);
+
+    if (size < sizeof(uint32_t)) {
+        return false;
+    }
+    uint32_t num_services;
+    std::memcpy(&num_services, data, sizeof(num_services));
+    const uint8_t *cursor = data + sizeof(uint32_t);
+    const uint8_t *end = data + size;
+
+    // 数量本身先和最小记录长度比较，拒绝伪造的超大数量
+    if (num_services > size_t(end - cursor) / MIN_RECORD) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < num_services; ++i) {
+        // 除字符串外的定长部分一次检查；之后每个长度只需和剩余的可变部分比较一次
+        if (size_t(end - cursor) < MIN_RECORD) {
+            return false;
+        }
+        uint64_t budget = uint64_t(end - cursor) - MIN_RECORD;
+        uint32_t lengths[3];
+        const char *strings[3];
+        uint64_t used = 0;
+        for (int field = 0; field < 3; ++field) {
+            std::memcpy(&lengths[field], cursor, sizeof(uint32_t));
+            used += lengths[field];
+            if (used > budget) {
+                return false;
+            }
+            strings[field] = reinterpret_cast<const char *>(cursor + sizeof(uint32_t));
+            cursor += sizeof(uint32_t) + lengths[field];
+        }
+        fn(ServiceView{
+                std::string_view(strings[0], lengths[0]),
+                std::string_view(strings[1], lengths[1]),
+                std::string_view(strings[2], lengths[2]),
+                *cursor != 0
+        });
+        cursor += sizeof(uint8_t);
+    }
+
+    return cursor == end;
+}
+
+#endif //REGISTRYCPP_SERVICECODEC_H
@@ -10,16 +10,18 @@
 #include <string>
 #include <iomanip>
 #include <utility>
+#include <algorithm>
 
 bool isValidUUID(const std::string &uuid);
 
 double calculateDistance(const LocationInfo &a, const LocationInfo &b);
 
-void printServiceRegistry(const std::map<std::string, std::vector<Service>>& registry);
+void printServiceRegistry(const ServiceTable& registry);
 
 std::vector<uint8_t> mock_receive_message();
-std::vector<uint8_t> serialize_services(const std::vector<Service>& services);
-std::vector<Service> deserialize_services(const std::vector<uint8_t>& data);
+
+template<typename Fn>
+bool forEachService(const std::vector<uint8_t>& payload, Fn&& fn);
 
 // Initiation for testing
 void ServiceRegistry::initialize(const std::vector<Service>& services) {
@@ -33,6 +35,7 @@ void ServiceRegistry::initialize(const std::vector<Service>& services) {
     for (const auto& service : services) {
         registry[service.service_name].push_back(service);
     }
+    invalidateSlots();
 
     // 构建Merkle树
     buildMerkleTree();
@@ -61,12 +64,19 @@ Response ServiceRegistry::registerService(const ServiceRegisterRequest &request)
 
         // 添加到注册表中
         registry[request.service_name].push_back(newService);
+        invalidateSlots();
+        buildMerkleTree();
         return Response(0, Response::STATUS_SUCCESS, "Register Success.", RespVariant{});
     }
 }
 
 Response ServiceRegistry::deregisterService(const ServiceDeregisterRequest &request) {
-    auto &instances = registry[request.service_name];
+    // 用find查找，不为未知的服务类型插入空列表
+    auto it = registry.find(request.service_name);
+    if (it == registry.end()) {
+        return Response(0, Response::STATUS_NOT_FOUND, "Instance not found.", RespVariant{});
+    }
+    auto &instances = it->second;
     auto originalSize = instances.size(); // 保存原始大小以判断是否有元素被删除
 
     instances.erase(
@@ -75,10 +85,16 @@ Response ServiceRegistry::deregisterService(const ServiceDeregisterRequest &requ
                                return instance.instance_id == request.instance_id;
                            }),
             instances.end());
-
-    if (instances.size() == originalSize) {
+    // 必须在erase节点之前计算，之后instances已经被销毁
+    bool removed = instances.size() != originalSize;
+    if (!removed) {
         return Response(0, Response::STATUS_NOT_FOUND, "Instance not found.", RespVariant{});
     }
+    if (instances.empty()) {
+        registry.erase(it);  // 不保留空的服务类型，与Merkle叶子保持一一对应
+    }
+    invalidateSlots();
+    buildMerkleTree();
 
     return Response(0, Response::STATUS_SUCCESS, "Deregister Success.", RespVariant{});
 }
@@ -87,28 +103,25 @@ Response ServiceRegistry::deregisterService(const ServiceDeregisterRequest &requ
 // 技术点之一 服务的匹配
 Response ServiceRegistry::findService(const FindServiceRequest &request) {
     // 解析 service_name 以获取 MethodId
-    std::istringstream iss(request.service_name);
-    std::string segment;
-    std::vector<std::string> seglist;
-
-    while (std::getline(iss, segment, '.')) {
-        seglist.push_back(segment);
-    }
-
-    if (seglist.size() < 3) {
+    std::string_view methodId = serviceTypeOf(request.service_name);
+    if (methodId.empty()) {
         return Response(0, Response::STATUS_ERROR, "Invalid service name format.", RespVariant{});
     }
 
-    std::string methodId = seglist[2];  // 获取 MethodId
-
     // 查找具有相应 MethodId 的服务
     auto it = registry.find(methodId);
-    if (it != registry.end() && !it->second.empty()) {
+    if (it != registry.end() && !it->second.empty() && request.descriptor.mode == 2) {
+        // 负载均衡：不扫描全部实例，避免所有消费者同时涌向同一个"最优"实例
+        if (Service *picked = pickLessLoaded(it->second, request.exclude_instance)) {
+            FindServiceResponse findServiceResponse{Response::STATUS_SUCCESS, *picked};
+            return Response(0, Response::STATUS_SUCCESS, "", findServiceResponse);
+        }
+    } else if (it != registry.end() && !it->second.empty()) {
         Service *bestService = nullptr;
         double bestScore = std::numeric_limits<double>::max();
 
         for (Service &service : it->second) {
-            if (!service.is_alive) continue;
+            if (!service.is_alive || service.instance_id == request.exclude_instance) continue;
 
             double score;
             if (request.descriptor.mode == 0) { // 地理位置最近
@@ -136,15 +149,82 @@ Response ServiceRegistry::findService(const FindServiceRequest &request) {
     return Response(0, Response::STATUS_NOT_FOUND, "Service not found or no suitable service", RespVariant{});
 }
 
+// power of two choices：随机取两个存活实例，返回在途调用较少的一个，期望O(1)
+Service *ServiceRegistry::pickLessLoaded(std::vector<Service> &instances, const std::string &exclude) {
+    size_t n = instances.size();
+    auto eligible = [&instances, &exclude](size_t index) {
+        return instances[index].is_alive && instances[index].instance_id != exclude;
+    };
+    // 随机抽到存活实例，连续抽不到时说明存活的很少，退回到线性收集
+    auto drawAlive = [this, &instances, &eligible, n](size_t skip) -> Service * {
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            size_t index = balancerRng() % n;
+            if (index != skip && eligible(index)) {
+                return &instances[index];
+            }
+        }
+        std::vector<size_t> alive;
+        for (size_t index = 0; index < n; ++index) {
+            if (index != skip && eligible(index)) {
+                alive.push_back(index);
+            }
+        }
+        return alive.empty() ? nullptr : &instances[alive[balancerRng() % alive.size()]];
+    };
+
+    Service *first = drawAlive(n);
+    if (!first) {
+        return nullptr;
+    }
+    Service *second = drawAlive(static_cast<size_t>(first - instances.data()));
+    if (!second) {
+        return first;  // 只有一个存活实例
+    }
+    return outstandingCalls(second->instance_id) < outstandingCalls(first->instance_id) ? second : first;
+}
+
+void ServiceRegistry::reportLoad(const std::string &clientId, const std::vector<InstanceLoad> &loads) {
+    auto &previous = clientLoads[clientId];
+    for (const auto &load : previous) {
+        auto it = outstandingLoad.find(load.instance_id);
+        if (it != outstandingLoad.end()) {
+            it->second -= std::min(it->second, load.inflight);
+            if (it->second == 0) {
+                outstandingLoad.erase(it);
+            }
+        }
+    }
+    for (const auto &load : loads) {
+        if (load.inflight > 0) {
+            outstandingLoad[load.instance_id] += load.inflight;
+        }
+    }
+    if (loads.empty()) {
+        clientLoads.erase(clientId);
+    } else {
+        previous = loads;
+    }
+}
+
+uint32_t ServiceRegistry::outstandingCalls(const std::string &instance_id) const {
+    auto it = outstandingLoad.find(instance_id);
+    return it == outstandingLoad.end() ? 0 : it->second;
+}
+
 void ServiceRegistry::heartbeat(const HeartBeatRequest &request) {
+    bool revived = false;
     for (auto &entry: registry) {
         for (Service &service: entry.second) {
             if (service.instance_id == request.instance_id) {
+                revived |= !service.is_alive;
                 service.is_alive = true;  // 更新服务状态为活跃
                 break;
             }
         }
     }
+    if (revived) {
+        buildMerkleTree();  // 存活状态进入叶子哈希
+    }
 }
 
 LocationInfo ServiceRegistry::findServiceLocation(const std::string &instance_id) {
@@ -232,7 +312,7 @@ void ServiceRegistry::syncServiceListOnInit() {
     for (const auto& [service_name, services] : registry) {
         my_services.insert(my_services.end(), services.begin(), services.end());
     }
-    std::vector<uint8_t> serialized_services = serialize_services(my_services);
+    std::vector<uint8_t> serialized_services = encodeServices(my_services);
     sendSerializedServices(serialized_services);
     receiveAndDeserializeServices();
 }
@@ -244,10 +324,16 @@ void ServiceRegistry::sendSerializedServices(const std::vector<uint8_t> &seriali
 
 void ServiceRegistry::receiveAndDeserializeServices() {
     std::vector<uint8_t> received_data = mock_receive_message();
-    std::vector<Service> services = deserialize_services(received_data);
-
-    for (const auto& service : services) {
-        registry[service.service_name].push_back(service);
+    bool ok = forEachService(received_data, [this](const ServiceView& service) {
+        auto it = registry.find(service.service_name);
+        if (it == registry.end()) {
+            it = registry.emplace(std::string(service.service_name), std::vector<Service>()).first;
+        }
+        it->second.push_back(service.toService());
+    });
+    invalidateSlots();
+    if (!ok) {
+        std::cerr << "[" << registryName << "] Malformed service list received on init." << std::endl;
     }
 }
 
@@ -256,6 +342,7 @@ void ServiceRegistry::buildMerkleTree() {
     tree = merkle::Tree();
 
     // 遍历 registry 中的每个服务列表，计算其哈希值并插入到 Merkle 树中
+    std::map<std::string, std::string, std::less<>> hashes;
     for (const auto& entry : registry) {
         const std::vector<Service>& services = entry.second;
         if (!services.empty()) {
@@ -263,12 +350,52 @@ void ServiceRegistry::buildMerkleTree() {
             std::string hashValue = hashServices(services);
             merkle::Tree::Hash hash(hashValue);
             tree.insert(hash);
+            hashes.emplace(entry.first, std::move(hashValue));
+        }
+    }
+
+    // 计算根哈希；最后一个服务类型被注销后树为空，没有根
+    if (tree.num_leaves() > 0) {
+        auto rootHash = tree.root();
+        std::cout << "[" << registryName << "] Merkle Tree Root Hash: " << rootHash.to_string() << std::endl;
+    }
+
+    // 两份有序表归并，找出新增、删除或哈希变化的叶子
+    std::vector<std::string> changed;
+    auto oldIt = leafHashes.begin();
+    auto newIt = hashes.begin();
+    while (oldIt != leafHashes.end() || newIt != hashes.end()) {
+        if (newIt == hashes.end() || (oldIt != leafHashes.end() && oldIt->first < newIt->first)) {
+            changed.push_back(oldIt++->first);
+        } else if (oldIt == leafHashes.end() || newIt->first < oldIt->first) {
+            changed.push_back(newIt++->first);
+        } else {
+            if (oldIt->second != newIt->second) {
+                changed.push_back(newIt->first);
+            }
+            ++oldIt;
+            ++newIt;
         }
     }
+    leafHashes = std::move(hashes);
 
-    // 计算根哈希
-    auto rootHash = tree.root();
-    std::cout << "[" << registryName << "] Merkle Tree Root Hash: " << rootHash.to_string() << std::endl;
+    for (const auto& serviceType : changed) {
+        for (const auto& listener : changeListeners) {
+            listener.second(serviceType);
+        }
+    }
+}
+
+uint64_t ServiceRegistry::subscribeServiceChanges(std::function<void(const std::string &)> listener) {
+    uint64_t id = nextListenerId++;
+    changeListeners.emplace_back(id, std::move(listener));
+    return id;
+}
+
+void ServiceRegistry::unsubscribeServiceChanges(uint64_t id) {
+    changeListeners.erase(std::remove_if(changeListeners.begin(), changeListeners.end(),
+                                         [id](const auto& listener) { return listener.first == id; }),
+                          changeListeners.end());
 }
 
 void ServiceRegistry::setServiceList(const std::vector<Service>& services) {
@@ -279,6 +406,7 @@ void ServiceRegistry::setServiceList(const std::vector<Service>& services) {
     for (const auto& service : services) {
         registry[service.service_name].push_back(service);
     }
+    invalidateSlots();
 
     // 构建Merkle树
     buildMerkleTree();
@@ -326,6 +454,44 @@ std::vector<std::string> ServiceRegistry::compareAndSyncTree(const std::vector<u
 }
 
 std::vector<uint8_t> ServiceRegistry::serializeServicesForNames(const std::vector<std::string> &serviceNames) {
+    if (serviceNames.empty()) {
+        return {};
+    }
+
+    // 按槽位顺序收集本节点当前的服务状态，同时标出属于serviceNames的槽位
+    uint64_t layoutHash = LAYOUT_HASH_SEED;
+    std::vector<bool> alive;
+    std::vector<bool> requested;
+    for (const auto& [serviceName, services] : registry) {
+        bool wanted = std::find(serviceNames.begin(), serviceNames.end(), serviceName) != serviceNames.end();
+        for (const auto& service : services) {
+            if (service.nodeId == registryName) {
+                layoutHash = layoutHashStep(layoutHash, service.service_name, service.instance_id);
+                alive.push_back(service.is_alive);
+                requested.push_back(wanted);
+            }
+        }
+    }
+
+    // 布局与上次发布一致、只有is_alive翻转时，只发送serviceNames内翻转的槽位
+    // 其余槽位的published状态保持不变，翻转留到对方比较出差异、请求到那个服务时再发
+    // 没有任何翻转却仍有差异，说明对方没有收到之前的消息，回退到全量发送
+    if (published.valid && published.layoutHash == layoutHash) {
+        std::vector<LivenessChange> changes;
+        for (uint32_t slot = 0; slot < alive.size(); ++slot) {
+            if (requested[slot] && alive[slot] != published.alive[slot]) {
+                changes.push_back({slot, alive[slot]});
+            }
+        }
+        if (!changes.empty()) {
+            for (const auto &change: changes) {
+                published.alive[change.slot] = change.is_alive;
+            }
+            return serializeLivenessDelta(registryName, ++livenessVersion, layoutHash,
+                                          static_cast<uint32_t>(alive.size()), changes);
+        }
+    }
+
     std::vector<Service> selectedServices;
 
     // 遍历传入的服务名列表
@@ -342,40 +508,176 @@ std::vector<uint8_t> ServiceRegistry::serializeServicesForNames(const std::vecto
         }
     }
 
+    // 没有需要同步的服务时不产生消息
+    if (selectedServices.empty()) {
+        return {};
+    }
+
+    published.valid = true;
+    published.layoutHash = layoutHash;
+    published.alive = std::move(alive);
+
     // 序列化选中的服务列表
-    return serialize_services(selectedServices);
+    return encodeServices(selectedServices);
+}
+
+void ServiceRegistry::setSyncFormat(ServiceWireFormat format) {
+    syncFormat = format;
+}
+
+std::vector<uint8_t> ServiceRegistry::encodeServices(const std::vector<Service> &services) const {
+    if (syncFormat == ServiceWireFormat::Compact) {
+        return serializeServicesCompact(services);
+    }
+    return serializeServicesFlat(services);
 }
 
 void ServiceRegistry::deserializeAndSetServices(const std::vector<uint8_t> &serializedServices) {
-    // 反序列化服务列表
-    std::vector<Service> deserializedServices = deserialize_services(serializedServices);
+    // 直接在接收缓冲区上访问服务记录，不做逐字段拷贝
+    if (serializedServices.empty()) {
+        return;
+    }
+    if (serializedServices[0] == static_cast<uint8_t>(ServiceWireFormat::LivenessDelta)) {
+        if (applyLivenessDelta(serializedServices)) {
+            buildMerkleTree();
+            std::cout << "[" << registryName << "] Applied liveness delta." << std::endl;
+        }
+        return;
+    }
+    if (!applyServiceViews(serializedServices)) {
+        std::cerr << "[" << registryName << "] Malformed service list, ignored." << std::endl;
+        return;
+    }
 
-    if(!deserializedServices.empty()){
+    buildMerkleTree();
+    std::cout << "[" << registryName << "] Deserialized and updated local registry." << std::endl;
+}
+
+bool ServiceRegistry::applyServiceViews(const std::vector<uint8_t> &serializedServices) {
+    // 先完整校验一遍，避免损坏的消息只应用了一半
+    size_t count = 0;
+    if (!forEachService(serializedServices, [&count](const ServiceView&) { ++count; }) || count == 0) {
+        return false;
+    }
+
+    // 第一遍：删除原有相同服务名和节点名的服务
+    forEachService(serializedServices, [this](const ServiceView& service) {
+        auto it = registry.find(service.service_name);
+        if (it == registry.end()) return;
+        auto& vec = it->second;
+        vec.erase(std::remove_if(vec.begin(), vec.end(),
+                                 [&service](const Service& s) {
+                                     return s.nodeId == service.nodeId;
+                                 }),
+                  vec.end());
+    });
+
+    // 第二遍：添加新的服务，只有写入registry时才物化字符串
+    forEachService(serializedServices, [this](const ServiceView& service) {
+        auto it = registry.find(service.service_name);
+        if (it == registry.end()) {
+            it = registry.emplace(std::string(service.service_name), std::vector<Service>()).first;
+        }
+        it->second.push_back(service.toService());
+    });
+    invalidateSlots();
+    return true;
+}
 
-        // 更新本地的 registry
-        for (const auto& service : deserializedServices) {
-            // 删除原有相同服务名和节点名的服务
-            auto& vec = registry[service.service_name];
+void ServiceRegistry::invalidateSlots() {
+    ++layoutEpoch;
+}
 
-            vec.erase(std::remove_if(vec.begin(), vec.end(),
-                                     [&service](const Service& s) {
-                                         return s.nodeId == service.nodeId;
-                                     }),
-                      vec.end());
+bool ServiceRegistry::applyLivenessDelta(const std::vector<uint8_t> &delta) {
+    LivenessDeltaReader reader(delta);
+    if (!reader.valid()) {
+        std::cerr << "[" << registryName << "] Malformed liveness delta, ignored." << std::endl;
+        return false;
+    }
 
-            // 添加新的服务
-            registry[service.service_name].push_back(service);
-//            printServiceRegistry(registry);
+    auto it = peerSlots.find(reader.nodeId());
+    if (it == peerSlots.end()) {
+        it = peerSlots.emplace(std::string(reader.nodeId()), PeerSlots()).first;
+    }
+    PeerSlots& peer = it->second;
+
+    // 乱序或重复的消息
+    if (reader.version() <= peer.version) {
+        return false;
+    }
+
+    // registry结构变化后重建一次槽位表，之后每条delta都是O(变化数)
+    if (!peer.built || peer.epoch != layoutEpoch) {
+        peer.slots.clear();
+        peer.layoutHash = LAYOUT_HASH_SEED;
+        for (auto& [serviceName, services] : registry) {
+            for (auto& service : services) {
+                if (service.nodeId == it->first) {
+                    peer.layoutHash = layoutHashStep(peer.layoutHash, service.service_name, service.instance_id);
+                    peer.slots.push_back(&service);
+                }
+            }
         }
+        peer.epoch = layoutEpoch;
+        peer.built = true;
+    }
 
-        buildMerkleTree();
-        std::cout << "[" << registryName << "] Deserialized and updated local registry." << std::endl;
+    if (peer.layoutHash != reader.layoutHash() || peer.slots.size() != reader.slotCount()) {
+        std::cerr << "[" << registryName << "] Liveness delta from " << it->first
+                  << " does not match local layout, waiting for full sync." << std::endl;
+        return false;
     }
 
+    // 先完整走一遍确认有效，再应用；损坏的delta一个槽位都不改，版本不变，等待全量同步
+    LivenessChange change{};
+    LivenessDeltaReader check = reader;
+    bool inRange = true;
+    while (inRange && check.next(change)) {
+        inRange = change.slot < peer.slots.size();
+    }
+    if (!check.valid() || !inRange) {
+        std::cerr << "[" << registryName << "] Malformed liveness delta from " << it->first
+                  << ", waiting for full sync." << std::endl;
+        return false;
+    }
 
+    while (reader.next(change)) {
+        peer.slots[change.slot]->is_alive = change.is_alive;
+    }
+    peer.version = reader.version();
+    return true;
 }
 
 //-----------辅助方法 未来调整一下文件结构
+
+// 按首字节分派到对应格式的解码器，逐条回调ServiceView；数据损坏时返回false
+template<typename Fn>
+bool forEachService(const std::vector<uint8_t>& payload, Fn&& fn) {
+    if (payload.empty()) {
+        return false;
+    }
+
+    switch (static_cast<ServiceWireFormat>(payload[0])) {
+        case ServiceWireFormat::Flat: {
+            FlatServiceList services(payload);
+            if (!services.valid()) return false;
+            for (ServiceView service : services) {
+                fn(service);
+            }
+            return true;
+        }
+        case ServiceWireFormat::Compact: {
+            CompactServiceReader reader(payload);
+            ServiceView service;
+            while (reader.next(service)) {
+                fn(service);
+            }
+            return reader.valid();
+        }
+        default:
+            return false;
+    }
+}
 bool isValidUUID(const std::string &uuid) {
     std::regex uuidRegex("^[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[1-5][0-9a-fA-F]{3}-[89abAB][0-9a-fA-F]{3}-[0-9a-fA-F]{12}$");
     return std::regex_match(uuid, uuidRegex);
@@ -460,38 +762,6 @@ std::vector<Service> ServiceRegistry::getServiceList() const {
 }
 
 
-std::vector<uint8_t> serialize_services(const std::vector<Service>& services) {
-    std::vector<uint8_t> result;
-
-    // 序列化服务数量
-    uint32_t num_services = services.size();
-    result.insert(result.end(), reinterpret_cast<const uint8_t*>(&num_services), reinterpret_cast<const uint8_t*>(&num_services) + sizeof(num_services));
-
-    for (const auto& service : services) {
-        service.serialize(result);
-    }
-
-    return result;
-}
-
-// 反序列化 std::vector<Service>
-std::vector<Service> deserialize_services(const std::vector<uint8_t>& data) {
-    size_t offset = 0;
-
-    uint32_t num_services;
-    std::memcpy(&num_services, &data[offset], sizeof(num_services));
-    offset += sizeof(num_services);
-
-    std::vector<Service> services;
-    services.reserve(num_services);
-
-    for (uint32_t i = 0; i < num_services; ++i) {
-        services.push_back(Service::deserialize(data, offset));
-    }
-
-    return services;
-}
-
 // 模拟接收消息的方法，返回包含服务信息的 std::vector<uint8_t>
 std::vector<uint8_t> mock_receive_message() {
     std::vector<Service> services = {
@@ -500,11 +770,11 @@ std::vector<uint8_t> mock_receive_message() {
             {"ExampleService3", "54321", "node3", true}
     };
 
-    return serialize_services(services);
+    return serializeServicesCompact(services);
 }
 
 
-void printServiceRegistry(const std::map<std::string, std::vector<Service>>& registry) {
+void printServiceRegistry(const ServiceTable& registry) {
     std::cout << "Service Registry Contents:" << std::endl;
     for (const auto& entry : registry) {
         const std::string& serviceType = entry.first;
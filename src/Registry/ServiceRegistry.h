@@ -8,23 +8,65 @@
 #include <string>
 #include <algorithm>
 #include <sstream>
+#include <functional>
+#include <random>
+#include <unordered_map>
 #include "merklecpp.h"
+#include "ServiceCodec.h"
 #include "../common/Service.h"
 #include "../common/Request.h"
 
+// 服务类型 -> 实例列表；透明比较器使得可以直接用string_view查找
+using ServiceTable = std::map<std::string, std::vector<Service>, std::less<>>;
+
 
 /// description
 /// 1. 初始化服务列表 2. 两个编队的有人机交换服务列表 3. 构建哈希树 4. 服务调用 5. 服务状态更新 6. 无人机增加、退出，导致树结构变化
 
 class ServiceRegistry {
 private:
+    // 本节点上一次发布给其他编队的服务状态，用于判断是否只有is_alive发生了变化
+    struct PublishedState {
+        bool valid = false;
+        uint64_t layoutHash = 0;
+        std::vector<bool> alive;  // 按槽位顺序
+    };
+
+    // 其他节点的槽位表缓存，registry结构不变时直接按槽位号定位到Service
+    struct PeerSlots {
+        uint64_t version = 0;       // 已应用的最新delta版本
+        uint64_t epoch = 0;         // 构建slots时的layoutEpoch
+        bool built = false;
+        uint64_t layoutHash = 0;
+        std::vector<Service*> slots;
+    };
+
     std::string registryName; // 新增的成员变量，用于存储注册表的名字
-    std::map<std::string, std::vector<Service>> registry;
+    ServiceTable registry;
     std::map<std::string, Node> nodeList;
+    ServiceWireFormat syncFormat = ServiceWireFormat::Compact; // 编队间同步使用的编码格式
+    PublishedState published;
+    uint64_t livenessVersion = 0;
+    uint64_t layoutEpoch = 0;   // registry的结构（增删服务）每变化一次加一，使槽位表缓存失效
+    std::map<std::string, PeerSlots, std::less<>> peerSlots;
+    std::map<std::string, std::string, std::less<>> leafHashes;  // 服务类型 -> 上一次构建时的叶子哈希
+    std::vector<std::pair<uint64_t, std::function<void(const std::string &)>>> changeListeners;
+    uint64_t nextListenerId = 1;
+
+    // 在途调用数：客户端各自上报绝对值，registry替换该客户端的旧值并维护按实例的合计
+    std::map<std::string, std::vector<InstanceLoad>, std::less<>> clientLoads;
+    std::unordered_map<std::string, uint32_t> outstandingLoad;
+    std::minstd_rand balancerRng{std::random_device{}()};
+
+    Service *pickLessLoaded(std::vector<Service> &instances, const std::string &exclude);
 
     void syncServiceListOnInit();
     void receiveAndDeserializeServices();
     void buildMerkleTree(); // 新增的构建Merkle树的方法
+    bool applyServiceViews(const std::vector<uint8_t> &serializedServices);
+    bool applyLivenessDelta(const std::vector<uint8_t> &delta);
+    void invalidateSlots();
+    std::vector<uint8_t> encodeServices(const std::vector<Service> &services) const;
 
 public:
 
@@ -46,6 +88,11 @@ public:
 
     void heartbeat(const HeartBeatRequest &request);
 
+    // clientId的全部在途调用数，覆盖它上一次的上报；空列表表示该客户端已没有在途调用
+    void reportLoad(const std::string &clientId, const std::vector<InstanceLoad> &loads);
+
+    uint32_t outstandingCalls(const std::string &instance_id) const;
+
     void sendSerializedServices(const std::vector<uint8_t>& serialized_services);
 
     LocationInfo findServiceLocation(const std::string &instance_id);
@@ -64,6 +111,14 @@ public:
 
     void initialize(const std::vector<Service>& services);
 
+    void setSyncFormat(ServiceWireFormat format);
+
+    // 某个服务类型的Merkle叶子变化（实例增删、存活状态变化、同步）时回调该类型名
+    // 回调在重建Merkle树的线程上同步执行，客户端据此精确失效解析缓存
+    uint64_t subscribeServiceChanges(std::function<void(const std::string &serviceType)> listener);
+
+    void unsubscribeServiceChanges(uint64_t id);
+
     std::vector<Service> getServiceList() const;
 };
 
@@ -0,0 +1,39 @@
+// ResponseBuilder.h
+
+#ifndef REGISTRYCPP_RESPONSEBUILDER_H
+#define REGISTRYCPP_RESPONSEBUILDER_H
+
+#include <string>
+#include <charconv>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * 处理函数拼接响应文本用，代替std::string的+和std::to_string
+ * 直接写进目标字符串：构造时清空但保留容量，整数用to_chars在栈上格式化，没有临时字符串
+ * 目标是工作线程复用的回复槽位里的字段，容量稳定之后拼接不再分配内存
+ */
+class ResponseBuilder {
+public:
+    explicit ResponseBuilder(std::string &out) : out(out) { out.clear(); }
+
+    ResponseBuilder &operator<<(std::string_view text) {
+        out.append(text.data(), text.size());
+        return *this;
+    }
+
+    // char和bool不按数字输出，不接受
+    template<typename Int, typename = std::enable_if_t<std::is_integral_v<Int> && !std::is_same_v<Int, bool> &&
+                                                       !std::is_same_v<Int, char>>>
+    ResponseBuilder &operator<<(Int value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr);
+        return *this;
+    }
+
+private:
+    std::string &out;
+};
+
+#endif //REGISTRYCPP_RESPONSEBUILDER_H
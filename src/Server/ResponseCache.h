@@ -0,0 +1,212 @@
+// ResponseCache.h
+
+#ifndef REGISTRYCPP_RESPONSECACHE_H
+#define REGISTRYCPP_RESPONSECACHE_H
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <condition_variable>
+#include "../common/Request.h"
+
+/**
+ * 幂等读方法的响应缓存，按方法开启
+ * 1. 键为参数编码的哈希，条目同时保存编码本身，哈希碰撞时按未命中处理
+ * 2. 只缓存成功的响应，条目在ttl后过期
+ * 3. 写方法成功后invalidate它影响的读方法，整个方法的条目清空并推进代数，执行中的读结果不再写回
+ * 4. 同样的参数同时未命中时只有第一个执行处理函数，其余等待它的结果（singleflight），结果不论成败都共享
+ *    等待不超过请求的截止时间（没有截止时间的最多MAX_FLIGHT_WAIT）：到了截止时间回STATUS_TIMEOUT，
+ *    否则自己执行一次、结果不写回缓存，工作线程不会因为一次卡住的处理函数全部停在同一个flight上
+ */
+class ResponseCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 超过后先清理过期条目，仍然满则不再写入
+    static constexpr size_t MAX_ENTRIES_PER_METHOD = 4096;
+    // 没有截止时间的请求等待其他线程执行结果的上限
+    static constexpr std::chrono::milliseconds MAX_FLIGHT_WAIT{1000};
+
+    void enable(MethodId id, std::chrono::milliseconds ttl) {
+        Table &table = tables[static_cast<size_t>(id)];
+        std::lock_guard<std::mutex> lock(table.mtx);
+        table.ttl = ttl;
+        table.enabled.store(ttl.count() > 0, std::memory_order_release);
+    }
+
+    bool enabled(MethodId id) const {
+        return tables[static_cast<size_t>(id)].enabled.load(std::memory_order_acquire);
+    }
+
+    // writer成功后清空reader的缓存；与bind一样在开始处理请求之前设置，之后只读
+    void invalidateOn(MethodId writer, MethodId reader) {
+        tables[static_cast<size_t>(writer)].invalidates.push_back(reader);
+    }
+
+    // 任一方法执行成功后调用，没有登记失效关系的方法只读一次空vector
+    void onWrite(MethodId writer) {
+        for (MethodId reader: tables[static_cast<size_t>(writer)].invalidates) {
+            invalidate(reader);
+        }
+    }
+
+    void invalidate(MethodId id) {
+        Table &table = tables[static_cast<size_t>(id)];
+        std::lock_guard<std::mutex> lock(table.mtx);
+        table.entries.clear();
+        ++table.generation;
+    }
+
+    /**
+     * 命中时把缓存的响应赋值到out；未命中时执行compute(out)，同样的参数正在执行时等待那一次的结果
+     * key为参数的编码；deadline为请求的截止时间，默认值表示不限
+     * out是复用的回复槽位，按赋值写入，字符串沿用槽位原有的容量
+     */
+    template<typename Compute>
+    void getOrCompute(MethodId id, const std::vector<uint8_t> &key, Clock::time_point deadline, Response &out,
+                      Compute &&compute) {
+        Table &table = tables[static_cast<size_t>(id)];
+        size_t hash = std::hash<std::string_view>{}(
+                std::string_view(reinterpret_cast<const char *>(key.data()), key.size()));
+
+        std::shared_ptr<Flight> flight;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(table.mtx);
+            auto it = table.entries.find(hash);
+            if (it != table.entries.end() && it->second.key == key) {
+                Entry &entry = it->second;
+                if (entry.flight) {
+                    // 同样的请求正在执行，等它完成
+                    auto pending = entry.flight;
+                    lock.unlock();
+                    bool limited = deadline != Clock::time_point();
+                    auto until = limited ? deadline : Clock::now() + MAX_FLIGHT_WAIT;
+                    if (pending->waitUntil(out, until)) {
+                        coalesced.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+                    abandoned.fetch_add(1, std::memory_order_relaxed);
+                    if (limited) {
+                        // 调用方已经放弃，回复也会被丢弃
+                        out.status = Response::STATUS_TIMEOUT;
+                        out.error.clear();
+                        out.responseBody = GetRadarStatusResponse{};  // 不回传槽位里上一次的内容
+                        return;
+                    }
+                    compute(out);
+                    return;
+                }
+                if (Clock::now() < entry.expires) {
+                    hits.fetch_add(1, std::memory_order_relaxed);
+                    out = entry.response;
+                    return;
+                }
+            }
+            misses.fetch_add(1, std::memory_order_relaxed);
+            flight = std::make_shared<Flight>();
+            generation = table.generation;
+            if (it != table.entries.end()) {
+                it->second = Entry{key, flight, Response(), Clock::time_point()};
+            } else if (table.entries.size() < MAX_ENTRIES_PER_METHOD || evictExpired(table)) {
+                table.entries.emplace(hash, Entry{key, flight, Response(), Clock::time_point()});
+            }
+        }
+
+        compute(out);
+
+        {
+            std::lock_guard<std::mutex> lock(table.mtx);
+            auto it = table.entries.find(hash);
+            bool ours = it != table.entries.end() && it->second.flight == flight;
+            if (ours && table.generation == generation && out.status == Response::STATUS_SUCCESS) {
+                it->second.flight = nullptr;
+                it->second.response = out;
+                it->second.expires = Clock::now() + table.ttl;
+            } else if (ours) {
+                table.entries.erase(it);  // 失败或执行期间被失效，不缓存
+            }
+        }
+        flight->set(out);
+    }
+
+    uint64_t hitCount() const { return hits.load(std::memory_order_relaxed); }
+
+    uint64_t missCount() const { return misses.load(std::memory_order_relaxed); }
+
+    uint64_t coalescedCount() const { return coalesced.load(std::memory_order_relaxed); }
+
+    // 等待其他线程的执行结果超时的次数
+    uint64_t abandonedCount() const { return abandoned.load(std::memory_order_relaxed); }
+
+private:
+    // 一次正在执行的未命中，等待者共享它的结果
+    class Flight {
+    public:
+        void set(const Response &result) {
+            std::lock_guard<std::mutex> lock(mtx);
+            response = result;
+            done = true;
+            cv.notify_all();
+        }
+
+        // 到until仍未完成时返回false，out不变
+        bool waitUntil(Response &out, Clock::time_point until) {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (!cv.wait_until(lock, until, [this]() { return done; })) {
+                return false;
+            }
+            out = response;
+            return true;
+        }
+
+    private:
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool done = false;
+        Response response;
+    };
+
+    struct Entry {
+        std::vector<uint8_t> key;
+        std::shared_ptr<Flight> flight;  // 非空表示正在执行
+        Response response;
+        Clock::time_point expires;
+    };
+
+    struct Table {
+        std::mutex mtx;
+        std::atomic<bool> enabled{false};
+        std::chrono::milliseconds ttl{0};
+        uint64_t generation = 0;
+        std::vector<MethodId> invalidates;  // 本方法作为写方法时失效的读方法，配置后只读，不加锁
+        std::unordered_map<size_t, Entry> entries;
+    };
+
+    // 调用方持有table.mtx；清理后有空位时返回true
+    static bool evictExpired(Table &table) {
+        auto now = Clock::now();
+        for (auto it = table.entries.begin(); it != table.entries.end();) {
+            if (!it->second.flight && now >= it->second.expires) {
+                it = table.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return table.entries.size() < MAX_ENTRIES_PER_METHOD;
+    }
+
+    std::array<Table, static_cast<size_t>(MethodId::Count)> tables;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> coalesced{0};
+    std::atomic<uint64_t> abandoned{0};
+};
+
+#endif //REGISTRYCPP_RESPONSECACHE_H
@@ -3,86 +3,233 @@
 //
 
 #include "Server.h"
+#include "../common/RpcCodec.h"
 #include <thread>
 #include <chrono>
 
 
-Server::Server() {
+Server::Server(size_t workerThreads)
+        : workers(workerThreads, {CRITICAL_QUEUE_CAPACITY, NORMAL_QUEUE_CAPACITY, BULK_QUEUE_CAPACITY}) {
     // Register methods
-    methods["Service.getRadarStatus"] = [this](Request& req) { return handle_getRadarStatus(req); };
-    methods["Service.setRadarStatus"] = [this](Request& req) { return handle_setRadarStatus(req); };
+    handlers.fill(&Server::rejectUnknown);
+    bind<GetRadarStatus, &Server::handle_getRadarStatus>();
+    bind<SetRadarStatus, &Server::handle_setRadarStatus>();
+    cache.invalidateOn(MethodId::SetRadarStatus, MethodId::GetRadarStatus);
+    idleJobs.reserve(MAX_IDLE_JOBS);
 
-    std::thread([this]() {
+    // 所有成员构造完之后再启动，析构时join
+    receiverThread = std::thread([this]() {
         this->receiveFromDDS();
-    }).detach();  // 启动线程并立即分离
+    });
 }
 
-Response Server::handle_getRadarStatus(Request& req) {
-    if (auto* stringArgs = std::get_if<GetRadarStatusRequest>(&req.body.param)) {
-        // 参数类型正确，处理请求
-        GetRadarStatusResponse getResponse;
-        getResponse.status = Response::STATUS_SUCCESS;
-        getResponse.message = "Receive request from " + stringArgs->from_service + " to " + stringArgs->to_service;
+Server::~Server() {
+    {
+        std::lock_guard<std::mutex> lock(receiverMtx);
+        receiverStopping = true;
+    }
+    receiverCv.notify_all();
+    receiverThread.join();  // 之后不会再有新的帧，workers析构时处理完已提交的任务
+}
+
+void Server::handle_getRadarStatus(const GetRadarStatusRequest& args, GetRadarStatusResponse& reply) {
+    // 参数类型由分派表保证
+    reply.status = Response::STATUS_SUCCESS;
+    ResponseBuilder(reply.message) << "Receive request from " << args.from_service << " to " << args.to_service;
+}
+
+void Server::handle_setRadarStatus(const SetRadarStatusRequest& args, SetRadarStatusResponse& reply) {
+    reply.status = Response::STATUS_SUCCESS;
+    ResponseBuilder(reply.message) << "处理成功: a = " << args.a << ", b = " << args.b;
+}
+
+void Server::dispatch(Request& req, Response& out) {
+    // 已经在工作线程上，直接调用；未注册的槽位是rejectUnknown
+    handlers[static_cast<size_t>(req.header.methodId)](*this, req, out);
+}
+
+void Server::rejectUnknown(Server&, Request& req, Response& out) {
+    // 错误说明由调用方按状态码给出，这里不构造字符串
+    out.seq = req.header.seq;
+    out.status = Response::STATUS_NOT_FOUND;
+    out.error.clear();
+    out.responseBody = GetRadarStatusResponse{};  // 不回传槽位里上一次的内容
+}
 
-        Response response(req.header.seq, getResponse.status, "----", getResponse);
 
-        return response;
-    } else {
-        // 参数类型不匹配，返回错误信息
-        GetRadarStatusResponse getResponse;
-        getResponse.status = Response::STATUS_ERROR;
-        getResponse.message = "错误: 参数类型不是GetRadarStatusArgs";
 
-        Response response(req.header.seq, getResponse.status, "参数类型错误", getResponse);
-        return response;
+bool Server::enableResponseCache(const std::string& method, std::chrono::milliseconds ttl) {
+    MethodId id = methodIdOf(method);
+    if (id == MethodId::Unknown) {
+        std::cerr << "Cannot cache unknown method " << method << std::endl;
+        return false;
     }
+    cache.enable(id, ttl);
+    return true;
 }
 
-Response Server::handle_setRadarStatus(Request& req) {
-    if (auto* intArgs = std::get_if<SetRadarStatusRequest>(&req.body.param)) {
-        // 成功转换，创建响应对象
-        SetRadarStatusResponse setResponse;
-        setResponse.status = Response::STATUS_SUCCESS;
-        setResponse.message = "处理成功: a = " + std::to_string(intArgs->a) + ", b = " + std::to_string(intArgs->b);
+bool Server::invalidateCacheOn(const std::string& writer, const std::string& reader) {
+    MethodId writerId = methodIdOf(writer);
+    MethodId readerId = methodIdOf(reader);
+    if (writerId == MethodId::Unknown || readerId == MethodId::Unknown) {
+        std::cerr << "Cannot link cache of unknown method " << writer << " -> " << reader << std::endl;
+        return false;
+    }
+    cache.invalidateOn(writerId, readerId);
+    return true;
+}
 
-        Response response(req.header.seq, setResponse.status, "====", setResponse);
-        return response;
-    } else {
-        // 转换失败，创建错误响应
-        SetRadarStatusResponse setResponse;
-        setResponse.status = Response::STATUS_ERROR;
-        setResponse.message = "错误: 参数类型不是MyArgsIntDemo";
-
-        Response response(req.header.seq, setResponse.status, "参数类型错误", setResponse);
-        return response;
-    }
-}
-
-Response Server::dispatch(Request& req) {
-    auto it = methods.find(req.header.serviceMethod);
-    if (it != methods.end()) {
-        std::promise<Response> responsePromise;
-        std::future<Response> responseFuture = responsePromise.get_future();
-        std::thread t([this, it, &req, &responsePromise]() {
-            Response response = it->second(req);
-            responsePromise.set_value(response); // 将结果存入promise
-        });
-        t.detach();
-        return responseFuture.get(); // 获取并返回异步执行的结果
-    } else {
-        Response errorResponse;
-        errorResponse.status = Response::STATUS_NOT_FOUND;
-        errorResponse.error = "Error: Method not found";
-        return errorResponse;
+void Server::processRequest(Request& req, Response& out) {
+    MethodId id = req.header.methodId;
+    if (cache.enabled(id)) {
+        thread_local std::vector<uint8_t> key;
+        encodeArgs(req.body.param, key);
+        cache.getOrCompute(id, key, req.header.deadline, out,
+                           [this, &req](Response& result) { dispatch(req, result); });
+        return;
+    }
+    dispatch(req, out);
+    if (out.status == Response::STATUS_SUCCESS) {
+        cache.onWrite(id);  // 写方法成功后失效受影响的读缓存
     }
 }
 
+/**
+ * 一个请求帧的处理状态，处理完后回到idleJobs复用
+ * requests和responses只增长不收缩，前count个有效：请求原地解码，响应由handler原地填写，字符串都沿用上一帧的容量
+ * remaining比请求数多一，由processFrame在提交完所有任务后释放，保证提交期间job不会被回收
+ */
+struct Server::FrameJob {
+    explicit FrameJob(Server* server) : server(server) {}
 
+    Server* const server;  // 任务只捕获job和下标，放得进std::function的内联存储
+    std::vector<Request> requests;
+    std::vector<Response> responses;
+    std::vector<uint8_t> dropped;  // 已过期、不回复的请求，各任务只写自己的下标
+    size_t count = 0;
+    std::atomic<size_t> remaining{0};
+    std::chrono::steady_clock::time_point arrived;  // 帧到达的时间，排队和端到端延迟的起点
+};
 
-Response Server::processRequest(Request& req) {
-    Response result = dispatch(req);
-    // add additional logic to send the message
-    return result;
+Server::FrameJob* Server::acquireJob() {
+    {
+        std::lock_guard<std::mutex> lock(jobPoolMtx);
+        if (!idleJobs.empty()) {
+            FrameJob* job = idleJobs.back().release();
+            idleJobs.pop_back();
+            return job;
+        }
+    }
+    return new FrameJob(this);
+}
+
+void Server::releaseJob(FrameJob* job) {
+    {
+        std::lock_guard<std::mutex> lock(jobPoolMtx);
+        if (idleJobs.size() < MAX_IDLE_JOBS) {
+            idleJobs.emplace_back(job);
+            return;
+        }
+    }
+    delete job;
+}
+
+size_t Server::processFrame(const uint8_t* data, size_t size) {
+    FrameJob* job = acquireJob();
+    job->arrived = std::chrono::steady_clock::now();
+    job->count = 0;
+    bool intact = forEachBatchedMessage(data, size, [job](const uint8_t* message, size_t length) {
+        if (job->count == job->requests.size()) {
+            job->requests.emplace_back();
+        }
+        if (decodeRequest(message, length, job->requests[job->count], false)) {
+            ++job->count;
+        } else {
+            std::cerr << "Malformed request dropped (" << length << " bytes)" << std::endl;
+        }
+    });
+    if (!intact) {
+        std::cerr << "Malformed request frame (" << size << " bytes)" << std::endl;
+    }
+    size_t count = job->count;
+    if (count == 0) {
+        releaseJob(job);
+        return 0;
+    }
+
+    // 同一帧里的请求由工作线程并行处理，接收线程不等待
+    if (job->responses.size() < count) {
+        job->responses.resize(count);
+    }
+    job->dropped.assign(count, 0);
+    job->remaining.store(count + 1, std::memory_order_relaxed);
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        const RequestHeader& header = job->requests[i].header;
+        if (header.expired(now)) {
+            job->dropped[i] = 1;  // 在传输中就已经过期，不占队列
+            finishRequest(job);
+            continue;
+        }
+        auto lane = static_cast<size_t>(header.priority);
+        bool accepted = workers.submit(lane, [job, i]() { job->server->runRequest(job, i); });
+        if (!accepted) {
+            // 该优先级已经过载，立即拒绝，调用方可以退避后重试
+            Response& busy = job->responses[i];
+            busy.status = Response::STATUS_BUSY;
+            busy.error.clear();
+            busy.responseBody = GetRadarStatusResponse{};
+            finishRequest(job);
+        }
+    }
+    finishRequest(job);  // 提交方持有的那一份
+    return count;
+}
+
+void Server::runRequest(FrameJob* job, size_t index) {
+    Request& req = job->requests[index];
+    if (req.header.expired(std::chrono::steady_clock::now())) {
+        job->dropped[index] = 1;  // 排队期间调用方已经放弃
+    } else {
+        MethodType& method = stats[req.header.methodId];
+        auto started = std::chrono::steady_clock::now();
+        method.queue.record(started - job->arrived);
+        processRequest(req, job->responses[index]);
+        method.handler.record(std::chrono::steady_clock::now() - started);
+    }
+    finishRequest(job);
+}
+
+void Server::finishRequest(FrameJob* job) {
+    // 最后完成的一条负责把整帧的响应合并发回，然后回收job
+    if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    // 可能在任一工作线程或接收线程上，缓冲区按线程复用
+    thread_local FrameBatchWriter replies;
+    thread_local std::vector<uint8_t> message;
+    replies.clear();
+    auto finished = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < job->count; ++i) {
+        MethodType& method = stats[job->requests[i].header.methodId];
+        if (job->dropped[i] || job->requests[i].header.expired(finished)) {
+            expiredDropped.fetch_add(1, std::memory_order_relaxed);  // 调用方已经超时，回复也会被丢弃
+            method.errors.add();
+            continue;
+        }
+        Response& response = job->responses[i];
+        method.endToEnd.record(finished - job->arrived);
+        if (response.status != Response::STATUS_SUCCESS) {
+            method.errors.add();
+        }
+        response.seq = job->requests[i].header.seq;  // 缓存命中或被拒绝时槽位里不是本请求的seq
+        encodeResponse(response, message);
+        replies.append(message);
+    }
+    if (!replies.empty()) {
+        sendByDDS(replies);
+    }
+    releaseJob(job);
 }
 
 //    std::string method = "Service.getRadarStatus";  // 选择一个默认方法
@@ -116,8 +263,12 @@ Response Server::processRequest(Request& req) {
 //    // 可以根据实际情况来处理这个响应，比如打印信息，或者触发其他的操作
 //    std::cout << "Response received: " << response.error << std::endl;
 
-[[noreturn]] void Server::receiveFromDDS() {
-    while (true) {
+void Server::receiveFromDDS() {
+    FrameBatchWriter batch;
+    std::vector<uint8_t> message;
+    std::unique_lock<std::mutex> lock(receiverMtx);
+    while (!receiverStopping) {
+        lock.unlock();
         // Prepare the first request for Service.getRadarStatus
         RequestHeader header1("Service.getRadarStatus", 0);
         GetRadarStatusRequest getArgs{};
@@ -132,26 +283,25 @@ Response Server::processRequest(Request& req) {
         setArgs.b = 20;
         Request req2(header2, setArgs);
 
-        // Launch both requests asynchronously in parallel
-        std::future<Response> future1 = std::async(std::launch::async, &Server::processRequest, this, std::ref(req1));
-        std::future<Response> future2 = std::async(std::launch::async, &Server::processRequest, this, std::ref(req2));
-
-        // Wait for both async tasks to complete
-        Response response1 = future1.get();
-        Response response2 = future2.get();
-
-        // Output the responses
-        sendByDDS(response1);
-        sendByDDS(response2);
+        // 模拟客户端把两条请求合并成一帧发来
+        batch.clear();
+        encodeRequest(req1, message);
+        batch.append(message);
+        encodeRequest(req2, message);
+        batch.append(message);
+        processFrame(batch.bytes().data(), batch.bytes().size());
 
         // Wait six seconds before repeating the loop
-        std::this_thread::sleep_for(std::chrono::seconds(6));
+        lock.lock();
+        receiverCv.wait_for(lock, std::chrono::seconds(6), [this]() { return receiverStopping; });
     }
 }
 
-void Server::sendByDDS(Response& response){
-    std::cout<<"Process finished, response sent by dds"<< response.error << std::endl;
+void Server::sendByDDS(const FrameBatchWriter& batch){
+    //TODO 接入DDS后发送frame
+#ifdef REGISTRYCPP_TRACE_DDS
+    std::cerr << "Process finished, " << batch.messages() << " response(s) sent by dds (" << batch.bytes().size() << " bytes)\n";
+#else
+    (void) batch;
+#endif
 }
-
-
-
@@ -6,21 +6,124 @@
 #define REGISTRYCPP_SERVER_H
 
 
-#include <unordered_map>
+#include <array>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <condition_variable>
 #include "../common/Request.h"
+#include "../common/RpcMethods.h"
+#include "../common/FrameBatch.h"
+#include "../common/MethodStats.h"
+#include "WorkerPool.h"
+#include "ResponseCache.h"
+#include "ResponseBuilder.h"
 
+/**
+ * 分派表按MethodId下标存放函数指针，查找不做字符串哈希，也没有std::function
+ * bind<M, &Server::handler>()在编译期检查handler的参数和回复类型与方法描述M一致
+ * handler不返回值，而是填写传入的回复对象：它是复用槽位里的响应体，所有字段都要重新赋值，文本用ResponseBuilder拼接
+ * 构造时每个槽位先填rejectUnknown，解码保证methodId小于Count，分派只有一次下标读取，没有判空分支
+ * 未知方法（包括按名字调用、没有编号的MethodId::Unknown）返回只带状态码的404，不分配内存
+ */
+
+/**
+ * 请求处理
+ * 接收线程只负责拆帧解码，每条请求作为一个任务交给定长的工作线程池，不再为每个请求创建线程
+ * 同一帧的请求由最后完成的工作线程合并成一帧回复，接收线程不等待处理结果
+ * 每帧的请求和响应放在复用的FrameJob里：请求原地解码，响应由handler原地填写后直接编码进回复帧，中间不复制、不移动
+ * 按请求头的priority进入对应通道，每个优先级的队列单独限长，工作线程总是先处理高优先级的请求
+ * 某个优先级的队列满时，该请求立即以STATUS_BUSY回复（不带错误字符串），不阻塞接收线程，也不影响其他优先级
+ * 请求头带有调用方的剩余时间，解码时换算成本地steady_clock上的截止时间：入队前、出队后、回复前各检查一次，已过期的请求不执行也不回复
+ * 过载时排队过久的请求由此自动丢弃，处理能力留给调用方还在等待的请求
+ * 每个方法的排队、处理、端到端延迟和错误数记在stats中，通过methodStats()读取或startStatsDump定期输出
+ * 幂等的读方法可以用enableResponseCache开启响应缓存，写方法成功后按invalidateCacheOn登记的关系失效
+ */
 class Server {
 private:
-    std::unordered_map<std::string, std::function<Response(Request&)>> methods;
-    static void sendByDDS(Response& response);
+    using Invoker = void (*)(Server&, Request&, Response&);
+    std::array<Invoker, static_cast<size_t>(MethodId::Count)> handlers{};
+    static void rejectUnknown(Server& server, Request& req, Response& out);
+
+    // 取出M的参数类型调用handler；回复体在out里原地取出，已经是M的回复类型时沿用原有对象和容量
+    template<typename M, void (Server::*Handler)(const typename M::ArgsType&, typename M::ReplyType&)>
+    static void invoke(Server& server, Request& req, Response& out) {
+        using Reply = typename M::ReplyType;
+        out.seq = req.header.seq;
+        auto* args = std::get_if<typename M::ArgsType>(&req.body.param);
+        if (!args) {
+            out.status = Response::STATUS_ERROR;
+            out.error = "参数类型错误";
+            out.responseBody.template emplace<Reply>();
+            return;
+        }
+        if (!std::holds_alternative<Reply>(out.responseBody)) {
+            out.responseBody.template emplace<Reply>();
+        }
+        Reply& reply = *std::get_if<Reply>(&out.responseBody);
+        (server.*Handler)(*args, reply);
+        out.status = reply.status;
+        out.error.clear();
+    }
+
+    template<typename M, void (Server::*Handler)(const typename M::ArgsType&, typename M::ReplyType&)>
+    void bind() {
+        handlers[static_cast<size_t>(M::id)] = &invoke<M, Handler>;
+    }
+    static void sendByDDS(const FrameBatchWriter& batch);
+
+    struct FrameJob;
+    FrameJob* acquireJob();
+    void releaseJob(FrameJob* job);
+    void runRequest(FrameJob* job, size_t index);
+    void finishRequest(FrameJob* job);
+    // 空闲的FrameJob，各vector和其中的字符串保留容量
+    static constexpr size_t MAX_IDLE_JOBS = 64;
+    std::mutex jobPoolMtx;
+    std::vector<std::unique_ptr<FrameJob>> idleJobs;
+    std::atomic<uint64_t> expiredDropped{0};
+    MethodStats stats;
+    ResponseCache cache;
+
+    // 每个工作线程上各优先级的队列容量，按Priority顺序
+    static constexpr size_t CRITICAL_QUEUE_CAPACITY = 256;
+    static constexpr size_t NORMAL_QUEUE_CAPACITY = 1024;
+    static constexpr size_t BULK_QUEUE_CAPACITY = 256;
+    // 任务会用到上面的成员，必须最后构造、最先析构
+    WorkerPool workers;
+
+    // 模拟DDS的接收线程，会调用processFrame；析构时先停止并join，再析构上面的成员
+    std::thread receiverThread;
+    std::mutex receiverMtx;
+    std::condition_variable receiverCv;
+    bool receiverStopping = false;
 
 public:
-    Server();
-    Response handle_getRadarStatus(Request& req);
-    Response handle_setRadarStatus(Request& req);
-    Response dispatch(Request& req);
-    Response processRequest(Request& req);
-    [[noreturn]] void receiveFromDDS();
+    // workerThreads为0时按硬件线程数
+    explicit Server(size_t workerThreads = 0);
+    ~Server();
+    void handle_getRadarStatus(const GetRadarStatusRequest& args, GetRadarStatusResponse& reply);
+    void handle_setRadarStatus(const SetRadarStatusRequest& args, SetRadarStatusResponse& reply);
+    // 结果写入out，out通常是复用的槽位，字符串沿用原有容量
+    void dispatch(Request& req, Response& out);
+    void processRequest(Request& req, Response& out);
+    // 拆开一个合并的请求帧交给工作线程处理，不等待结果，全部完成后响应合并成一帧发回；返回请求数
+    size_t processFrame(const uint8_t* data, size_t size);
+    // 因截止时间已过而丢弃的请求数
+    uint64_t droppedExpired() const { return expiredDropped.load(std::memory_order_relaxed); }
+
+    const MethodStats& methodStats() const { return stats; }
+
+    // 缓存method的成功响应ttl时长，ttl为0关闭；未知方法返回false
+    bool enableResponseCache(const std::string& method, std::chrono::milliseconds ttl);
+    // writer执行成功后清空reader的响应缓存；应在开始处理请求之前设置，未知方法返回false
+    bool invalidateCacheOn(const std::string& writer, const std::string& reader);
+    const ResponseCache& responseCache() const { return cache; }
+    // 每隔interval把各方法的统计输出到std::cerr
+    void startStatsDump(std::chrono::milliseconds interval) { stats.startPeriodicDump(interval, std::cerr, "server"); }
+    // 接收循环，直到析构时被停止
+    void receiveFromDDS();
 };
 
 
@@ -0,0 +1,176 @@
+// WorkerPool.h
+
+#ifndef REGISTRYCPP_WORKERPOOL_H
+#define REGISTRYCPP_WORKERPOOL_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * 定长工作线程池，每个线程为每条通道（优先级）各有一个有界环形队列，通道0优先级最高
+ * 1. submit按轮转选线程，放入该通道的队列；该通道在所有线程上都满时返回false，由调用方决定如何拒绝
+ *    各通道的容量互不占用，低优先级通道满了不影响高优先级任务入队
+ * 2. 线程按通道从高到低取任务：先从自己队列的头部取，空了再从其他线程同一通道的头部偷
+ *    同一通道内先到先处理：任务都带截止时间，从尾部取会让最早到达的请求一直被后来者插队，最先过期
+ *    高优先级任务只需等正在执行的任务结束，不排在低优先级任务后面
+ *    某个处理函数阻塞时，排在它后面的任务会被空闲线程偷走，不会一直等
+ * 3. 所有队列都空时线程休眠，submit只在确实有线程休眠时才加锁唤醒
+ * 析构时等线程处理完已经放入的任务再退出
+ */
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    // threadCount为0时按硬件线程数；laneCapacity[i]为每个线程上通道i的队列容量
+    WorkerPool(size_t threadCount, std::vector<size_t> laneCapacity) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            workers.push_back(std::make_unique<Worker>(laneCapacity));
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads.emplace_back(&WorkerPool::run, this, i);
+        }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(idleMtx);
+            stopping = true;
+        }
+        idleCv.notify_all();
+        for (auto &thread: threads) {
+            thread.join();
+        }
+    }
+
+    // 任意线程调用；lane的队列都满时返回false，task不会被执行
+    bool submit(size_t lane, Task task) {
+        size_t start = next.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < workers.size(); ++i) {
+            Worker &worker = *workers[(start + i) % workers.size()];
+            {
+                std::lock_guard<std::mutex> lock(worker.mtx);
+                Ring &ring = worker.lanes[lane];
+                if (ring.count == ring.slots.size()) {
+                    continue;
+                }
+                ring.slots[(ring.head + ring.count) % ring.slots.size()] = std::move(task);
+                ++ring.count;
+                queued.fetch_add(1);
+            }
+            wakeOne();
+            return true;
+        }
+        return false;
+    }
+
+    size_t size() const { return workers.size(); }
+
+private:
+    // 环形队列，所属线程从尾部取，其他线程从头部偷
+    struct Ring {
+        std::vector<Task> slots;
+        size_t head = 0;
+        size_t count = 0;
+    };
+
+    struct Worker {
+        explicit Worker(const std::vector<size_t> &laneCapacity) : lanes(laneCapacity.size()) {
+            for (size_t lane = 0; lane < lanes.size(); ++lane) {
+                lanes[lane].slots.resize(std::max<size_t>(1, laneCapacity[lane]));
+            }
+        }
+
+        std::mutex mtx;  // 保护所有通道
+        std::vector<Ring> lanes;
+    };
+
+    bool take(size_t self, Task &out) {
+        for (size_t lane = 0; lane < workers[self]->lanes.size(); ++lane) {
+            if (popOwn(self, lane, out) || steal(self, lane, out)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(size_t self) {
+        Task task;
+        while (true) {
+            if (take(self, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(idleMtx);
+            sleeping.fetch_add(1);
+            // 声明休眠之后再检查一次，与submit中先计数再看sleeping配对，避免错过刚放入的任务
+            idleCv.wait(lock, [this]() { return queued.load() > 0 || stopping; });
+            sleeping.fetch_sub(1);
+            if (stopping && queued.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    // 调用方持有所属线程的mtx
+    bool popFront(Ring &ring, Task &out) {
+        if (ring.count == 0) {
+            return false;
+        }
+        out = std::move(ring.slots[ring.head]);
+        ring.head = (ring.head + 1) % ring.slots.size();
+        --ring.count;
+        queued.fetch_sub(1);
+        return true;
+    }
+
+    bool popOwn(size_t self, size_t lane, Task &out) {
+        Worker &worker = *workers[self];
+        std::lock_guard<std::mutex> lock(worker.mtx);
+        return popFront(worker.lanes[lane], out);
+    }
+
+    bool steal(size_t self, size_t lane, Task &out) {
+        for (size_t i = 1; i < workers.size(); ++i) {
+            Worker &victim = *workers[(self + i) % workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if (popFront(victim.lanes[lane], out)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void wakeOne() {
+        if (sleeping.load() > 0) {
+            // 持锁一次，保证休眠方要么还没检查条件、要么已经在等待
+            { std::lock_guard<std::mutex> lock(idleMtx); }
+            idleCv.notify_one();
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> queued{0};  // 所有队列中的任务总数
+    std::atomic<int> sleeping{0};
+    std::mutex idleMtx;
+    std::condition_variable idleCv;
+    bool stopping = false;
+};
+
+#endif //REGISTRYCPP_WORKERPOOL_H
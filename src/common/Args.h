@@ -8,22 +8,31 @@
 #include <utility>
 
 #include "string"
+#include <tuple>
+#include <variant>
 #include "Service.h"
 
 
 
 /**
  * RequestBody部分
+ * 每个结构体通过fields()列出参与编码的字段，编解码由Wire.h生成
  */
 
 struct GetRadarStatusRequest {
     std::string from_service;
     std::string to_service;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&GetRadarStatusRequest::from_service, &GetRadarStatusRequest::to_service);
+    }
 };
 
 struct SetRadarStatusRequest {
     int a;
     int b;
+
+    static constexpr auto fields() { return std::make_tuple(&SetRadarStatusRequest::a, &SetRadarStatusRequest::b); }
 };
 
 /**
@@ -34,20 +43,34 @@ struct GetRadarStatusResponse {
 public:
     int status;
     std::string message;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&GetRadarStatusResponse::status, &GetRadarStatusResponse::message);
+    }
 };
 
 struct SetRadarStatusResponse {
 public:
     int status;
     std::string message;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&SetRadarStatusResponse::status, &SetRadarStatusResponse::message);
+    }
 };
 
 struct FindServiceResponse {
     int status;   // 用于表示服务查找操作的状态码
     Service service;  // 存放找到的服务实例信息
 
+    FindServiceResponse() : status(0), service{"", "", "", false} {}
+
     // 可以添加构造函数来方便地初始化这个结构体
     FindServiceResponse(int stat, Service srv) : status(stat), service(std::move(srv)) {}
+
+    static constexpr auto fields() {
+        return std::make_tuple(&FindServiceResponse::status, &FindServiceResponse::service);
+    }
 };
 
 using ArgVariant = std::variant<GetRadarStatusRequest, SetRadarStatusRequest, FindServiceRequest>;
@@ -0,0 +1,104 @@
+// DdsChannel.h
+
+#ifndef REGISTRYCPP_DDSCHANNEL_H
+#define REGISTRYCPP_DDSCHANNEL_H
+
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+
+/**
+ * DDS topic的进程内替身：发布方写入编码好的帧，订阅方阻塞等待
+ * 订阅方只在确实休眠时才被唤醒，一次receive取走当前到达的全部帧，按批处理
+ * 帧缓冲区循环使用：订阅方处理完后recycle交还，publish(data, size)把数据复制进交还的缓冲区
+ * 接入真正的DDS后由DataReader的监听回调代替publish
+ */
+class DdsChannel {
+public:
+    using Frame = std::vector<uint8_t>;
+
+    static constexpr size_t MAX_SPARE_FRAMES = 64;
+
+    // 复制到回收的缓冲区后发布，稳态下不分配
+    void publish(const uint8_t *data, size_t size) {
+        Frame frame;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (closed) {
+                return;
+            }
+            if (!spare.empty()) {
+                frame = std::move(spare.back());
+                spare.pop_back();
+            }
+        }
+        frame.assign(data, data + size);
+        publish(std::move(frame));
+    }
+
+    void publish(Frame frame) {
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (closed) {
+                return;
+            }
+            frames.push_back(std::move(frame));
+            wake = waiting;
+        }
+        if (wake) {
+            cv.notify_one();
+        }
+    }
+
+    // 阻塞到至少有一帧或通道关闭；out会被清空后换入全部已到达的帧
+    // 关闭且没有剩余帧时返回false
+    bool receive(std::vector<Frame> &out) {
+        out.clear();
+        std::unique_lock<std::mutex> lock(mtx);
+        if (frames.empty() && !closed) {
+            waiting = true;
+            cv.wait(lock, [this]() { return !frames.empty() || closed; });
+            waiting = false;
+        }
+        if (frames.empty()) {
+            return false;
+        }
+        frames.swap(out);
+        return true;
+    }
+
+    // 交还receive取走的帧，done被清空；超出MAX_SPARE_FRAMES的缓冲区直接释放
+    void recycle(std::vector<Frame> &done) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto &frame: done) {
+                if (spare.size() >= MAX_SPARE_FRAMES) {
+                    break;
+                }
+                spare.push_back(std::move(frame));
+            }
+        }
+        done.clear();
+    }
+
+    // 之后的publish被丢弃，已经到达的帧仍可以取走
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            closed = true;
+        }
+        cv.notify_all();
+    }
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<Frame> frames;
+    std::vector<Frame> spare;  // 订阅方交还的空闲缓冲区
+    bool waiting = false;
+    bool closed = false;
+};
+
+#endif //REGISTRYCPP_DDSCHANNEL_H
@@ -0,0 +1,76 @@
+// FrameBatch.h
+
+#ifndef REGISTRYCPP_FRAMEBATCH_H
+#define REGISTRYCPP_FRAMEBATCH_H
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "Varint.h"
+
+/**
+ * 多条RPC消息合并成一个传输帧：[varint长度 | 消息] 重复到帧尾，单条消息也按同样格式发送
+ * 小请求在DDS上的开销主要是每条消息本身，合并后按帧分摊
+ * 请求帧和响应帧使用同一格式，两端都用forEachBatchedMessage拆包
+ */
+
+// Nagle式的合并策略：链路空闲时第一条消息立即发出，忙时最多攒maxDelay再发
+struct BatchPolicy {
+    size_t maxMessages = 64;                       // 单帧最多消息数，1表示不合并
+    size_t maxBytes = 16 * 1024;                   // 单帧字节数上限，超过后立即发出
+    std::chrono::microseconds maxDelay{200};       // 第一条消息入帧后最多等待的时间
+};
+
+class FrameBatchWriter {
+public:
+    void append(const uint8_t *data, size_t size) {
+        size_t offset = frame.size();
+        frame.resize(offset + varintSize(size) + size);
+        uint8_t *cursor = writeVarint(frame.data() + offset, size);
+        std::memcpy(cursor, data, size);
+        ++count;
+    }
+
+    void append(const std::vector<uint8_t> &message) { append(message.data(), message.size()); }
+
+    // 已经达到策略规定的上限，应当立即发出
+    bool full(const BatchPolicy &policy) const {
+        return count >= policy.maxMessages || frame.size() >= policy.maxBytes;
+    }
+
+    bool empty() const { return count == 0; }
+
+    size_t messages() const { return count; }
+
+    const std::vector<uint8_t> &bytes() const { return frame; }
+
+    // 保留容量，下一帧不再分配
+    void clear() {
+        frame.clear();
+        count = 0;
+    }
+
+private:
+    std::vector<uint8_t> frame;
+    size_t count = 0;
+};
+
+// 依次把帧中每条消息交给fn(const uint8_t*, size_t)；帧格式错误时停止并返回false，已交出的消息不受影响
+template<typename Fn>
+bool forEachBatchedMessage(const uint8_t *data, size_t size, Fn &&fn) {
+    const uint8_t *cursor = data;
+    const uint8_t *end = data + size;
+    while (cursor != end) {
+        uint64_t length;
+        if (!readVarint(cursor, end, length) || length > static_cast<uint64_t>(end - cursor)) {
+            return false;
+        }
+        fn(cursor, static_cast<size_t>(length));
+        cursor += length;
+    }
+    return true;
+}
+
+#endif //REGISTRYCPP_FRAMEBATCH_H
@@ -0,0 +1,163 @@
+// LatencyHistogram.h
+
+#ifndef REGISTRYCPP_LATENCYHISTOGRAM_H
+#define REGISTRYCPP_LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * HDR式的对数-线性延迟直方图，单位微秒
+ * 小于SUB_BUCKETS的值每个值一个桶；之后每个2的幂区间均分为SUB_BUCKETS个桶，相对误差不超过1/SUB_BUCKETS（约3%）
+ * 超过2^MAX_BITS微秒（约71分钟）的值记在最后一个桶
+ * 计数分成SHARDS个分片，每个线程固定写其中一个，记录只有relaxed的fetch_add，不加锁；读取时合并所有分片
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 5;
+    static constexpr uint64_t SUB_BUCKETS = uint64_t(1) << SUB_BITS;
+    static constexpr unsigned MAX_BITS = 32;
+    static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+    static constexpr size_t SHARDS = 4;
+
+    // 合并后的计数，percentile返回所在桶的上界（不小于真实值）
+    struct Snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t max = 0;
+
+        uint64_t percentile(double q) const {
+            if (count == 0) {
+                return 0;
+            }
+            auto rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < buckets.size(); ++i) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    uint64_t upper = upperBound(i);
+                    return upper < max ? upper : max;
+                }
+            }
+            return max;
+        }
+    };
+
+    void record(uint64_t micros) {
+        Shard &shard = shards[shardIndex()];
+        shard.buckets[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t seen = shard.max.load(std::memory_order_relaxed);
+        while (micros > seen && !shard.max.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    void record(std::chrono::steady_clock::duration elapsed) {
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        record(micros > 0 ? static_cast<uint64_t>(micros) : 0);
+    }
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (const Shard &shard: shards) {
+            for (const auto &bucket: shard.buckets) {
+                total += bucket.load(std::memory_order_relaxed);
+            }
+        }
+        return total;
+    }
+
+    Snapshot snapshot() const {
+        Snapshot merged;
+        merged.buckets.assign(BUCKETS, 0);
+        for (const Shard &shard: shards) {
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                uint64_t n = shard.buckets[i].load(std::memory_order_relaxed);
+                merged.buckets[i] += n;
+                merged.count += n;
+            }
+            uint64_t max = shard.max.load(std::memory_order_relaxed);
+            merged.max = max > merged.max ? max : merged.max;
+        }
+        return merged;
+    }
+
+    static size_t bucketOf(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = highestBit(value);
+        if (msb >= MAX_BITS) {
+            return BUCKETS - 1;
+        }
+        // 第group组覆盖[2^msb, 2^(msb+1))，组内按最高SUB_BITS+1位定位
+        unsigned group = msb - SUB_BITS + 1;
+        return group * SUB_BUCKETS + static_cast<size_t>(value >> (msb - SUB_BITS)) - SUB_BUCKETS;
+    }
+
+    static uint64_t upperBound(size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        uint64_t group = bucket / SUB_BUCKETS;
+        uint64_t sub = bucket % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub + 1) << (group - 1)) - 1;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        std::atomic<uint64_t> max{0};
+    };
+
+    static unsigned highestBit(uint64_t value) {
+#if defined(__GNUC__)
+        return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#else
+        unsigned bit = 0;
+        while (value >>= 1) ++bit;
+        return bit;
+#endif
+    }
+
+    // 线程第一次记录时按顺序分到一个分片，之后固定不变
+    static size_t shardIndex() {
+        static std::atomic<size_t> nextShard{0};
+        thread_local size_t index = nextShard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return index;
+    }
+
+    std::array<Shard, SHARDS> shards{};
+};
+
+// 按线程分片的计数器，与LatencyHistogram使用同样的分片方式
+class ShardedCounter {
+public:
+    void add(uint64_t n = 1) { cells[cellIndex()].value.fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t load() const {
+        uint64_t total = 0;
+        for (const Cell &cell: cells) {
+            total += cell.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<uint64_t> value{0};
+    };
+
+    static size_t cellIndex() {
+        static std::atomic<size_t> nextCell{0};
+        thread_local size_t index = nextCell.fetch_add(1, std::memory_order_relaxed) % LatencyHistogram::SHARDS;
+        return index;
+    }
+
+    std::array<Cell, LatencyHistogram::SHARDS> cells{};
+};
+
+#endif //REGISTRYCPP_LATENCYHISTOGRAM_H
@@ -0,0 +1,148 @@
+// MethodStats.h
+
+#ifndef REGISTRYCPP_METHODSTATS_H
+#define REGISTRYCPP_METHODSTATS_H
+
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ostream>
+#include <typeindex>
+#include <condition_variable>
+#include "Request.h"
+#include "RpcMethods.h"
+
+// 一个直方图的分位数，单位微秒
+struct LatencySummary {
+    uint64_t count = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+
+    static LatencySummary of(const LatencyHistogram &histogram) {
+        auto snapshot = histogram.snapshot();
+        return LatencySummary{snapshot.count, snapshot.percentile(0.5), snapshot.percentile(0.99),
+                              snapshot.percentile(0.999), snapshot.max};
+    }
+};
+
+struct MethodStatsSnapshot {
+    std::string method;
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    LatencySummary queue;
+    LatencySummary handler;
+    LatencySummary endToEnd;
+};
+
+/**
+ * 按MethodId下标存放的MethodType表，Server和Client各有一份
+ * 记录直接写对应MethodType的直方图；snapshot合并各分片后给出分位数，只在读取时有开销
+ * startPeriodicDump启动一个线程，每隔interval把snapshot输出一次
+ */
+class MethodStats {
+public:
+    MethodStats() {
+        methods[0] = std::make_unique<MethodType>(typeid(void), typeid(void));  // 未知方法
+        add<GetRadarStatus>();
+        add<SetRadarStatus>();
+        add<FindService>();
+        for (auto &method: methods) {
+            if (!method) {
+                method = std::make_unique<MethodType>(typeid(void), typeid(void));
+            }
+        }
+    }
+
+    MethodStats(const MethodStats &) = delete;
+
+    MethodStats &operator=(const MethodStats &) = delete;
+
+    ~MethodStats() { stopPeriodicDump(); }
+
+    MethodType &operator[](MethodId id) { return *methods[static_cast<size_t>(id)]; }
+
+    const MethodType &operator[](MethodId id) const { return *methods[static_cast<size_t>(id)]; }
+
+    // 只包含有过调用的方法
+    std::vector<MethodStatsSnapshot> snapshot() const {
+        std::vector<MethodStatsSnapshot> result;
+        for (size_t id = 0; id < methods.size(); ++id) {
+            const MethodType &method = *methods[id];
+            MethodStatsSnapshot stats;
+            stats.endToEnd = LatencySummary::of(method.endToEnd);
+            stats.errors = method.errors.load();
+            if (stats.endToEnd.count == 0 && stats.errors == 0) {
+                continue;
+            }
+            stats.method = id == 0 ? "<unknown>" : methodNameOf(static_cast<MethodId>(id));
+            stats.calls = stats.endToEnd.count;
+            stats.queue = LatencySummary::of(method.queue);
+            stats.handler = LatencySummary::of(method.handler);
+            result.push_back(std::move(stats));
+        }
+        return result;
+    }
+
+    void dump(std::ostream &out, const std::string &label) const {
+        auto print = [&out](const char *name, const LatencySummary &s) {
+            out << " " << name << " p50/p99/p999/max=" << s.p50 << "/" << s.p99 << "/" << s.p999 << "/" << s.max
+                << "us";
+        };
+        for (const auto &stats: snapshot()) {
+            out << "[" << label << "] " << stats.method << " calls=" << stats.calls << " errors=" << stats.errors;
+            print("queue", stats.queue);
+            print("handler", stats.handler);
+            print("e2e", stats.endToEnd);
+            out << "\n";
+        }
+        out.flush();
+    }
+
+    // 每隔interval输出一次；再次调用会替换之前的设置，out必须比本对象活得久
+    void startPeriodicDump(std::chrono::milliseconds interval, std::ostream &out, std::string label) {
+        stopPeriodicDump();
+        std::lock_guard<std::mutex> lock(dumpMtx);
+        dumpStopping = false;
+        dumpThread = std::thread([this, interval, &out, label = std::move(label)]() {
+            std::unique_lock<std::mutex> lock(dumpMtx);
+            while (!dumpCv.wait_for(lock, interval, [this]() { return dumpStopping; })) {
+                lock.unlock();
+                dump(out, label);
+                lock.lock();
+            }
+        });
+    }
+
+    void stopPeriodicDump() {
+        {
+            std::lock_guard<std::mutex> lock(dumpMtx);
+            dumpStopping = true;
+        }
+        dumpCv.notify_all();
+        if (dumpThread.joinable()) {
+            dumpThread.join();
+        }
+    }
+
+private:
+    template<typename M>
+    void add() {
+        methods[static_cast<size_t>(M::id)] = std::make_unique<MethodType>(typeid(typename M::ArgsType),
+                                                                          typeid(typename M::ReplyType));
+    }
+
+    std::array<std::unique_ptr<MethodType>, static_cast<size_t>(MethodId::Count)> methods;
+
+    std::mutex dumpMtx;
+    std::condition_variable dumpCv;
+    bool dumpStopping = false;
+    std::thread dumpThread;
+};
+
+#endif //REGISTRYCPP_METHODSTATS_H
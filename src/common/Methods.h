@@ -0,0 +1,43 @@
+// Methods.h
+
+#ifndef REGISTRYCPP_METHODS_H
+#define REGISTRYCPP_METHODS_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+/**
+ * RPC方法编号，线上只传编号不传"Service.Method"字符串
+ * 编号一旦发布就不能改变含义，新增方法只能追加
+ */
+enum class MethodId : uint16_t {
+    Unknown = 0,
+    GetRadarStatus = 1,
+    SetRadarStatus = 2,
+    FindService = 3,
+    Count
+};
+
+// 编号 -> "Service.Method"，返回静态字符串，查表不分配内存
+inline const std::string &methodNameOf(MethodId id) {
+    static const std::string names[] = {
+            "",
+            "Service.getRadarStatus",
+            "Service.setRadarStatus",
+            "Registry.findService",
+    };
+    auto index = static_cast<size_t>(id);
+    return index < static_cast<size_t>(MethodId::Count) ? names[index] : names[0];
+}
+
+inline MethodId methodIdOf(std::string_view serviceMethod) {
+    for (uint16_t id = 1; id < static_cast<uint16_t>(MethodId::Count); ++id) {
+        if (methodNameOf(static_cast<MethodId>(id)) == serviceMethod) {
+            return static_cast<MethodId>(id);
+        }
+    }
+    return MethodId::Unknown;
+}
+
+#endif //REGISTRYCPP_METHODS_H
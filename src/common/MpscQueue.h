@@ -0,0 +1,88 @@
+// MpscQueue.h
+
+#ifndef REGISTRYCPP_MPSCQUEUE_H
+#define REGISTRYCPP_MPSCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 有界无锁队列，多生产者单消费者
+ * 每个槽位带一个序号：序号等于入队位置时可写，等于位置+1时可读，读完后推进一整圈
+ * 生产者之间只竞争一次CAS，消费者不需要任何原子读改写
+ * 容量向上取整到2的幂，队列满时tryPush直接返回false，由调用方决定等待还是拒绝
+ */
+template<typename T>
+class MpscQueue {
+public:
+    explicit MpscQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // 任意线程调用
+    bool tryPush(T value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // 队列已满
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 只能由唯一的消费者线程调用
+    bool tryPop(T &out) {
+        Cell &cell = cells[dequeuePos & mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePos + 1) {
+            return false;
+        }
+        out = std::move(cell.value);
+        cell.value = T();
+        cell.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+        ++dequeuePos;
+        return true;
+    }
+
+    // 只能由消费者线程调用
+    bool empty() const {
+        return cells[dequeuePos & mask].sequence.load(std::memory_order_acquire) != dequeuePos + 1;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) size_t dequeuePos = 0;
+};
+
+#endif //REGISTRYCPP_MPSCQUEUE_H
@@ -7,6 +7,8 @@
 
 #include "Request.h"
 #include "Args.h"
+#include "Methods.h"
+#include "LatencyHistogram.h"
 #include <string>
 #include <map>
 #include <cstdint>
@@ -17,24 +19,37 @@
 #include <iostream>
 #include <utility>
 #include <future>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 
 /**
  * TODO
  * ResponseHeader的设计
  */
 
+/**
+ * 一个方法的类型信息和调用统计，统计在任意线程上记录，不加锁
+ * 服务端：queue为请求到达到开始处理，handler为处理函数执行，endToEnd为到达到回复发出
+ * 客户端：queue为send到写入帧，handler为写入帧到收到响应（传输加对端处理），endToEnd为send到调用完成，超时也计入
+ * errors为状态不是STATUS_SUCCESS的调用，以及因截止时间丢弃的请求
+ */
 class MethodType {
 public:
     std::type_index argType;
     std::type_index replyType;
-    uint64_t numCalls = 0;
+    LatencyHistogram queue;
+    LatencyHistogram handler;
+    LatencyHistogram endToEnd;
+    ShardedCounter errors;
 
     // 构造函数初始化类型索引
     MethodType(std::type_index aType, std::type_index rType)
             : argType(aType), replyType(rType) {}
 
-    // 调用计数增加函数
-    void incrementCalls() { ++numCalls; }
+    // 完成的调用数，每次调用恰好记录一次endToEnd
+    uint64_t numCalls() const { return endToEnd.count(); }
 };
 
 // 服务类
@@ -58,16 +73,41 @@ public:
 //    }
 //};
 
+// 请求优先级，数值越小越先处理；服务端每个优先级单独排队、单独限长，低优先级的洪泛不会挤占关键调用
+enum class Priority : uint8_t {
+    Critical = 0,  // 控制类调用，如setRadarStatus
+    Normal = 1,
+    Bulk = 2,      // 遥测等可以丢弃的调用
+    Count
+};
+
 // 请求头
 struct RequestHeader {
-    std::string serviceMethod;  // 服务和方法 "Service.Method"
+    std::string serviceMethod;  // 服务和方法 "Service.Method"，从线上解码的已知方法只填methodId
+    MethodId methodId = MethodId::Unknown;  // 线上传输的方法编号
+    Priority priority = Priority::Normal;  // 服务端排队使用的优先级
     uint64_t seq{};               // 客户端选择的序列号
+    // 本进程steady_clock上的截止时间，默认值表示不限；过了截止时间调用方已经放弃
+    // 线上只传剩余毫秒数，编码时由截止时间换算，解码时按本地时钟还原，两端不需要对时
+    std::chrono::steady_clock::time_point deadline{};
     std::string error;          // 错误信息
 
     RequestHeader() = default;
 
     RequestHeader(std::string sMethod, uint64_t s, std::string err = "")
-            : serviceMethod(std::move(sMethod)), seq(s), error(std::move(err)) {}
+            : serviceMethod(std::move(sMethod)), methodId(methodIdOf(serviceMethod)), seq(s), error(std::move(err)) {}
+
+    // 类型化调用直接给出编号，不构造方法名字符串
+    explicit RequestHeader(MethodId id, uint64_t s = 0) : methodId(id), seq(s) {}
+
+    // 方法名，优先使用编号对应的静态名字
+    const std::string &method() const {
+        return methodId != MethodId::Unknown ? methodNameOf(methodId) : serviceMethod;
+    }
+
+    bool expired(std::chrono::steady_clock::time_point now) const {
+        return deadline != std::chrono::steady_clock::time_point{} && now >= deadline;
+    }
 };
 
 // RequestBody
@@ -80,6 +120,8 @@ public:
 
     explicit RequestBody(const SetRadarStatusRequest &intDemo) : param(intDemo) {}
 
+    explicit RequestBody(ArgVariant args) : param(std::move(args)) {}
+
     ArgVariant param;
 };
 
@@ -89,6 +131,26 @@ public:
     static const int STATUS_NOT_FOUND = 404;     // 资源未找到
     static const int STATUS_ERROR = 500;         // 服务器内部错误
     static const int STATUS_UNAUTHORIZED = 401;  // 需要认证
+    static const int STATUS_BUSY = 503;          // 服务端该优先级的队列已满，请求未被处理，可以稍后重试
+    static const int STATUS_TIMEOUT = 504;       // 调用超时，未收到响应
+
+    // 响应没有带error时，日志里使用的状态说明
+    static const char *statusText(int status) {
+        switch (status) {
+            case STATUS_SUCCESS:
+                return "OK";
+            case STATUS_NOT_FOUND:
+                return "Method not found";
+            case STATUS_UNAUTHORIZED:
+                return "Unauthorized";
+            case STATUS_BUSY:
+                return "Server busy";
+            case STATUS_TIMEOUT:
+                return "Request timed out";
+            default:
+                return "Internal error";
+        }
+    }
 
 
     uint64_t seq{};               // 请求的序列号
@@ -118,13 +180,64 @@ public:
 
 };
 
+// 异步调用的完成回调，在接收线程上执行，应尽快返回
+using ResponseCallback = std::function<void(const Response &)>;
+
+/**
+ * 同步调用的完成通知，代替std::promise/std::future
+ * 结果直接写在对象内部，不分配共享状态；随Request一起被池复用，reset后可再次使用
+ * 复用时按赋值写入结果，字符串沿用上一次的容量
+ */
+class Completion {
+public:
+    Completion() = default;
+
+    // 只在没有等待方时移动（Request放进容器），移动得到的是一个未完成的新对象
+    Completion(Completion &&) noexcept {}
+
+    Completion &operator=(Completion &&) noexcept {
+        ready = false;
+        return *this;
+    }
+
+    void set(const Response &response) {
+        std::lock_guard<std::mutex> lock(mtx);
+        value = response;
+        ready = true;
+        // 持锁通知：等待方返回后可能立即回收本对象，解锁之后不能再访问它
+        cv.notify_one();
+    }
+
+    // 阻塞到set被调用，返回的引用在下一次reset之前有效
+    const Response &wait() {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this]() { return ready; });
+        return value;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mtx);
+        ready = false;
+    }
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool ready = false;
+    Response value;
+};
+
 class Request {
 public:
 
 
     RequestHeader header;
     RequestBody body;
-    std::promise<Response> promise;
+    Completion completion;
+    ResponseCallback callback;  // 非空时为异步调用，完成时回调而不是设置completion
+    std::atomic<uint32_t> *inflight = nullptr;  // 目标实例的在途计数，由Client维护，不参与编码
+    std::chrono::steady_clock::time_point sentAt;    // 客户端调用send的时间，只用于统计，不参与编码
+    std::chrono::steady_clock::time_point framedAt;  // 客户端写入发送帧的时间
 
     Request() = default;
 
@@ -136,12 +249,20 @@ public:
     Request(RequestHeader hdr, const SetRadarStatusRequest &intDemo)
             : header(std::move(hdr)), body(intDemo) {}
 
+    Request(RequestHeader hdr, ArgVariant args)
+            : header(std::move(hdr)), body(std::move(args)) {}
+
     void complete(const Response &response) {
-        promise.set_value(response);
+        if (callback) {
+            callback(response);
+        } else {
+            completion.set(response);
+        }
     }
 
-    std::future<Response> get_future() {
-        return promise.get_future();
+    // 同步调用方在send之后等待结果
+    const Response &wait() {
+        return completion.wait();
     }
 };
 
@@ -0,0 +1,151 @@
+// RpcCodec.h
+
+#ifndef REGISTRYCPP_RPCCODEC_H
+#define REGISTRYCPP_RPCCODEC_H
+
+#include <array>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <variant>
+#include "Wire.h"
+#include "Request.h"
+
+/// description
+/// Request / Response 的二进制编码
+/// 请求：uint16 methodId [methodId为0时跟 varint长度 + 方法名] | uint8 优先级 | varint seq | varint 剩余毫秒数(0为不限) | varint长度 + error
+///       | uint8 参数类型下标 | body
+/// 响应：varint seq | varint status(zigzag) | varint长度 + error | uint8 响应类型下标 | body
+/// body由Wire.h根据各结构体声明的fields()生成编解码
+/// 编码写入调用方复用的缓冲区，解码只为消息里的字符串分配内存
+
+// ----- variant分派
+
+namespace rpc_codec_detail {
+
+// 截止时间换算成线上的剩余毫秒数，向上取整；已经过期的写1，对端收到后立即按过期处理
+inline uint64_t remainingMillis(std::chrono::steady_clock::time_point deadline) {
+    if (deadline == std::chrono::steady_clock::time_point{}) {
+        return 0;
+    }
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return remaining.count() > 0 ? static_cast<uint64_t>(remaining.count()) : 1;
+}
+
+template<typename Variant, size_t I>
+bool decodeAlternative(WireReader &r, Variant &out) {
+    // 已经是同一类型时原地解码，复用字符串的容量
+    if (out.index() != I) {
+        out.template emplace<I>();
+    }
+    return wire::decode(r, *std::get_if<I>(&out));
+}
+
+// 类型下标 -> 解码函数的跳转表，由variant的类型列表在编译期生成
+template<typename Variant, size_t... I>
+constexpr auto makeDecodeTable(std::index_sequence<I...>) {
+    return std::array<bool (*)(WireReader &, Variant &), sizeof...(I)>{&decodeAlternative<Variant, I>...};
+}
+
+template<typename Variant>
+bool decodeVariant(WireReader &r, Variant &out) {
+    static constexpr auto table = makeDecodeTable<Variant>(std::make_index_sequence<std::variant_size_v<Variant>>{});
+    uint8_t index;
+    if (!r.getU8(index) || index >= table.size()) {
+        return false;
+    }
+    return table[index](r, out);
+}
+
+template<typename Variant>
+void encodeVariant(WireWriter &w, const Variant &value) {
+    w.putU8(static_cast<uint8_t>(value.index()));
+    std::visit([&w](const auto &body) { wire::encode(w, body); }, value);
+}
+
+}
+
+// out会被清空后写入，调用方保留同一个缓冲区即可避免重复分配
+inline void encodeRequest(const Request &request, std::vector<uint8_t> &out) {
+    out.clear();
+    WireWriter w(out);
+    const RequestHeader &header = request.header;
+    w.putU16(static_cast<uint16_t>(header.methodId));
+    if (header.methodId == MethodId::Unknown) {
+        w.putString(header.serviceMethod);
+    }
+    w.putU8(static_cast<uint8_t>(header.priority));
+    w.putVarint(header.seq);
+    w.putVarint(rpc_codec_detail::remainingMillis(header.deadline));
+    w.putString(header.error);
+    rpc_codec_detail::encodeVariant(w, request.body.param);
+}
+
+// 只编码参数部分（类型下标 + body），服务端响应缓存用作键
+inline void encodeArgs(const ArgVariant &args, std::vector<uint8_t> &out) {
+    out.clear();
+    WireWriter w(out);
+    rpc_codec_detail::encodeVariant(w, args);
+}
+
+// keepMethodName为false时跳过未知方法的名字，serviceMethod留空：服务端按编号分派，未知方法只回404，用不到名字
+inline bool decodeRequest(const uint8_t *data, size_t size, Request &request, bool keepMethodName = true) {
+    WireReader r(data, size);
+    RequestHeader &header = request.header;
+    uint16_t id;
+    if (!r.getU16(id) || id >= static_cast<uint16_t>(MethodId::Count)) {
+        return false;
+    }
+    header.methodId = static_cast<MethodId>(id);
+    header.serviceMethod.clear();
+    if (header.methodId == MethodId::Unknown) {
+        if (keepMethodName) {
+            r.getString(header.serviceMethod);
+        } else {
+            r.skipString();
+        }
+    }
+    uint8_t priority;
+    if (!r.getU8(priority) || priority >= static_cast<uint8_t>(Priority::Count)) {
+        return false;
+    }
+    header.priority = static_cast<Priority>(priority);
+    r.getVarint(header.seq);
+    uint64_t budget = 0;
+    r.getVarint(budget);
+    // 传输耗时不计入，服务端的截止时间比调用方晚一个单程延迟，不会提前丢弃调用方还在等的请求
+    header.deadline = budget == 0 ? std::chrono::steady_clock::time_point{}
+                                  : std::chrono::steady_clock::now() + std::chrono::milliseconds(budget);
+    r.getString(header.error);
+    return rpc_codec_detail::decodeVariant(r, request.body.param) && r.ok() && r.atEnd();
+}
+
+inline bool decodeRequest(const std::vector<uint8_t> &data, Request &request) {
+    return decodeRequest(data.data(), data.size(), request);
+}
+
+inline void encodeResponse(const Response &response, std::vector<uint8_t> &out) {
+    out.clear();
+    WireWriter w(out);
+    w.putVarint(response.seq);
+    w.putInt(response.status);
+    w.putString(response.error);
+    rpc_codec_detail::encodeVariant(w, response.responseBody);
+}
+
+inline bool decodeResponse(const uint8_t *data, size_t size, Response &response) {
+    WireReader r(data, size);
+    r.getVarint(response.seq);
+    r.getInt(response.status);
+    r.getString(response.error);
+    return rpc_codec_detail::decodeVariant(r, response.responseBody) && r.ok() && r.atEnd();
+}
+
+inline bool decodeResponse(const std::vector<uint8_t> &data, Response &response) {
+    return decodeResponse(data.data(), data.size(), response);
+}
+
+#endif //REGISTRYCPP_RPCCODEC_H
@@ -0,0 +1,63 @@
+// RpcMethods.h
+
+#ifndef REGISTRYCPP_RPCMETHODS_H
+#define REGISTRYCPP_RPCMETHODS_H
+
+#include <string>
+#include <utility>
+#include <variant>
+#include "Methods.h"
+#include "Args.h"
+#include "Request.h"
+
+/**
+ * 编译期方法描述：编号 + 参数类型 + 返回类型
+ * client.call<GetRadarStatus>(args) 只接受GetRadarStatusRequest，参数类型写错在编译期报错
+ * 服务端按编号下标定位处理函数，调用路径上不再有方法名字符串
+ * 新增方法：在Methods.h追加编号，在Args.h的ArgVariant/RespVariant中加入类型，再在这里声明描述
+ */
+template<MethodId Id, typename Args, typename Reply>
+struct RpcMethod {
+    static constexpr MethodId id = Id;
+    using ArgsType = Args;
+    using ReplyType = Reply;
+
+    static const std::string &name() { return methodNameOf(Id); }
+};
+
+struct GetRadarStatus : RpcMethod<MethodId::GetRadarStatus, GetRadarStatusRequest, GetRadarStatusResponse> {};
+struct SetRadarStatus : RpcMethod<MethodId::SetRadarStatus, SetRadarStatusRequest, SetRadarStatusResponse> {};
+struct FindService : RpcMethod<MethodId::FindService, FindServiceRequest, FindServiceResponse> {};
+
+// 类型化调用的结果，status/error取自Response，reply为该方法声明的返回类型
+template<typename Reply>
+struct RpcResult {
+    int status = Response::STATUS_ERROR;
+    std::string error;
+    Reply reply{};
+
+    bool ok() const { return status == Response::STATUS_SUCCESS; }
+};
+
+// 写入调用方复用的result，字符串沿用其容量
+template<typename Reply>
+void toRpcResult(const Response &response, RpcResult<Reply> &result) {
+    result.status = response.status;
+    result.error = response.error;
+    if (auto *reply = std::get_if<Reply>(&response.responseBody)) {
+        result.reply = *reply;
+    } else if (result.ok()) {
+        // 成功却带着别的类型，说明两端的方法编号不一致
+        result.status = Response::STATUS_ERROR;
+        result.error = "Unexpected reply type.";
+    }
+}
+
+template<typename Reply>
+RpcResult<Reply> toRpcResult(const Response &response) {
+    RpcResult<Reply> result;
+    toRpcResult(response, result);
+    return result;
+}
+
+#endif //REGISTRYCPP_RPCMETHODS_H
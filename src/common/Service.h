@@ -2,6 +2,10 @@
 // Created by 黄迪 on 2024/4/16.
 //
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <cstring>
+#include <variant>
 #include <utility>
 #include <iostream>
 #include <sstream>
@@ -44,18 +48,38 @@ struct Service {
     std::string nodeId;       // 服务所在节点ID
     bool is_alive;            // 是否健康活跃
 
-    void serialize(std::vector<uint8_t>& out) const {
+    static constexpr auto fields() {
+        return std::make_tuple(&Service::service_name, &Service::instance_id, &Service::nodeId, &Service::is_alive);
+    }
+
+    // serialize写出的字节数：3个uint32长度 + 字符串 + 1字节is_alive
+    size_t serialized_size() const {
+        return 3 * sizeof(uint32_t) + service_name.size() + instance_id.size() + nodeId.size() + sizeof(uint8_t);
+    }
+
+    // 写入预先分配好的缓冲区，返回写入之后的位置
+    uint8_t* serialize_to(uint8_t* out) const {
         auto serialize_string = [&out](const std::string& str) {
             uint32_t length = str.size();
-            out.insert(out.end(), reinterpret_cast<const uint8_t*>(&length), reinterpret_cast<const uint8_t*>(&length) + sizeof(length));
-            out.insert(out.end(), str.begin(), str.end());
+            std::memcpy(out, &length, sizeof(length));
+            out += sizeof(length);
+            std::memcpy(out, str.data(), str.size());
+            out += str.size();
         };
 
         serialize_string(service_name);
         serialize_string(instance_id);
         serialize_string(nodeId);
-        out.push_back(static_cast<uint8_t>(is_alive));
+        *out++ = static_cast<uint8_t>(is_alive);
+        return out;
     }
+
+    void serialize(std::vector<uint8_t>& out) const {
+        size_t offset = out.size();
+        out.resize(offset + serialized_size());
+        serialize_to(out.data() + offset);
+    }
+    // 不做边界检查，调用方需保证数据完整；来自网络的数据使用deserialize_services
     static Service deserialize(const std::vector<uint8_t>& in, size_t& offset) {
         auto deserialize_string = [&in, &offset]() {
             uint32_t length;
@@ -77,6 +101,22 @@ struct Service {
     }
 };
 
+/**
+ * Service的只读视图，字段直接指向接收缓冲区，不做任何拷贝
+ * 视图的生命周期不能超过底层缓冲区
+ */
+struct ServiceView {
+    std::string_view service_name;
+    std::string_view instance_id;
+    std::string_view nodeId;
+    bool is_alive;
+
+    // 需要长期保存时才物化为Service
+    Service toService() const {
+        return Service{std::string(service_name), std::string(instance_id), std::string(nodeId), is_alive};
+    }
+};
+
 //// 定义一个结构体来表示服务的位置信息
 //struct LocationInfo {
 //    double latitude;  // 纬度
@@ -89,22 +129,37 @@ struct PerformanceMetrics {
     double responseTime; // 响应时间，单位为毫秒
     double uptime;       // 正常运行时间百分比
     int throughput;      // 吞吐量，单位为请求/秒
+
+    static constexpr auto fields() {
+        return std::make_tuple(&PerformanceMetrics::responseTime, &PerformanceMetrics::uptime,
+                               &PerformanceMetrics::throughput);
+    }
 };
 
 struct LocationInfo {
     double latitude;  // 纬度
     double longitude; // 经度
     std::string region; // 区域描述，例如区域代码
+
+    static constexpr auto fields() {
+        return std::make_tuple(&LocationInfo::latitude, &LocationInfo::longitude, &LocationInfo::region);
+    }
 };
 
 struct ServiceDescriptor {
-    int mode;                       // 匹配模式 0-地理位置最相近；1-性能最好
+    int mode;                       // 匹配模式 0-地理位置最相近；1-性能最好；2-随机两个实例中在途调用较少的
     LocationInfo location;          // 服务的地理位置信息
     PerformanceMetrics performance; // 性能指标
 
+    ServiceDescriptor() : mode(0), location{0.0, 0.0, ""}, performance{0.0, 0.0, 0} {}
+
     // 构造函数，初始化服务描述
     ServiceDescriptor(int mode, LocationInfo loc, PerformanceMetrics perf)
             : mode(mode), location(std::move(loc)), performance(perf) {}
+
+    static constexpr auto fields() {
+        return std::make_tuple(&ServiceDescriptor::mode, &ServiceDescriptor::location, &ServiceDescriptor::performance);
+    }
 };
 
 
@@ -113,9 +168,41 @@ struct ServiceDescriptor {
 struct FindServiceRequest {
     std::string service_name;
     ServiceDescriptor descriptor;
+    std::string exclude_instance;   // 非空时跳过该实例，用于给对冲请求找第二个实例
+
+    FindServiceRequest() = default;
 
     FindServiceRequest(std::string name, ServiceDescriptor desc)
             : service_name(std::move(name)), descriptor(std::move(desc)) {}
+
+    static constexpr auto fields() {
+        return std::make_tuple(&FindServiceRequest::service_name, &FindServiceRequest::descriptor,
+                               &FindServiceRequest::exclude_instance);
+    }
+};
+
+// "NodeName.ServiceName.MethodId" -> "MethodId"，即registry中的服务类型；格式不对时返回空
+inline std::string_view serviceTypeOf(std::string_view serviceName) {
+    size_t first = serviceName.find('.');
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    size_t second = serviceName.find('.', first + 1);
+    if (second == std::string_view::npos) {
+        return {};
+    }
+    std::string_view rest = serviceName.substr(second + 1);
+    return rest.substr(0, rest.find('.'));
+}
+
+// 客户端上报的某个实例的在途调用数，registry按实例汇总后用于负载均衡
+struct InstanceLoad {
+    std::string instance_id;
+    uint32_t inflight = 0;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&InstanceLoad::instance_id, &InstanceLoad::inflight);
+    }
 };
 
 struct ServiceRegisterRequest {
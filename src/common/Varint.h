@@ -0,0 +1,57 @@
+// Varint.h
+
+#ifndef REGISTRYCPP_VARINT_H
+#define REGISTRYCPP_VARINT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * LEB128无符号变长整数：每字节低7位为数据，最高位表示后面还有字节
+ * 小于128的值只占1个字节，适合长度、下标这类通常很小的字段
+ */
+
+inline size_t varintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+inline uint8_t *writeVarint(uint8_t *out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+inline void writeVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// 读取失败（越界或超过10字节）时返回false，cursor不保证停在原处
+inline bool readVarint(const uint8_t *&cursor, const uint8_t *end, uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (cursor == end) {
+            return false;
+        }
+        uint8_t byte = *cursor++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif //REGISTRYCPP_VARINT_H
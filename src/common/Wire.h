@@ -0,0 +1,311 @@
+// Wire.h
+
+#ifndef REGISTRYCPP_WIRE_H
+#define REGISTRYCPP_WIRE_H
+
+#include <vector>
+#include <string>
+#include <tuple>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "Varint.h"
+
+/// description
+/// 线上编码的基础读写器，以及根据字段列表自动生成的结构体编解码
+/// 结构体在自身定义中声明 static constexpr auto fields()，返回成员指针的tuple，例如
+///     static constexpr auto fields() { return std::make_tuple(&Foo::a, &Foo::b); }
+/// wire::encode / wire::decode / wire::encodedSize 按字段顺序处理：
+/// 1. 算术类型和枚举按自身宽度原样写入（小端），bool占1字节
+/// 2. std::string写 varint长度 + 字节
+/// 3. 声明了fields()的结构体递归展开
+/// 所有字段都是定长时整个结构体是定长的，大小在编译期算出，编码时只扩容一次后逐字段memcpy
+
+class WireWriter {
+public:
+    explicit WireWriter(std::vector<uint8_t> &out) : out(out) {}
+
+    void putU8(uint8_t value) { out.push_back(value); }
+
+    void putU16(uint16_t value) {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    void putVarint(uint64_t value) { writeVarint(out, value); }
+
+    void putInt(int64_t value) { writeVarint(out, (uint64_t(value) << 1) ^ uint64_t(value >> 63)); }
+
+    void putBool(bool value) { out.push_back(static_cast<uint8_t>(value)); }
+
+    void putDouble(double value) {
+        uint8_t bytes[sizeof(value)];
+        std::memcpy(bytes, &value, sizeof(value));
+        out.insert(out.end(), bytes, bytes + sizeof(bytes));
+    }
+
+    void putString(const std::string &value) {
+        writeVarint(out, value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    // 一次性扩出n字节，返回起始位置，供定长字段直接写入
+    uint8_t *grow(size_t n) {
+        size_t offset = out.size();
+        out.resize(offset + n);
+        return out.data() + offset;
+    }
+
+private:
+    std::vector<uint8_t> &out;
+};
+
+// 任何一次读取越界后ok()为false，后续读取全部失败，调用方只需在最后检查一次
+class WireReader {
+public:
+    WireReader(const uint8_t *data, size_t size) : cursor(data), end(data + size) {}
+
+    explicit WireReader(const std::vector<uint8_t> &buffer) : WireReader(buffer.data(), buffer.size()) {}
+
+    bool ok() const { return good; }
+
+    bool atEnd() const { return cursor == end; }
+
+    bool getU8(uint8_t &value) {
+        if (!good || cursor == end) return fail();
+        value = *cursor++;
+        return true;
+    }
+
+    bool getU16(uint16_t &value) {
+        if (!good || end - cursor < 2) return fail();
+        value = static_cast<uint16_t>(cursor[0] | cursor[1] << 8);
+        cursor += 2;
+        return true;
+    }
+
+    bool getVarint(uint64_t &value) {
+        if (!good || !readVarint(cursor, end, value)) return fail();
+        return true;
+    }
+
+    template<typename Int>
+    bool getInt(Int &value) {
+        uint64_t raw;
+        if (!getVarint(raw)) return false;
+        value = static_cast<Int>(static_cast<int64_t>((raw >> 1) ^ (~(raw & 1) + 1)));
+        return true;
+    }
+
+    bool getBool(bool &value) {
+        uint8_t byte;
+        if (!getU8(byte)) return false;
+        value = byte != 0;
+        return true;
+    }
+
+    bool getDouble(double &value) {
+        if (!good || end - cursor < static_cast<ptrdiff_t>(sizeof(value))) return fail();
+        std::memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
+        return true;
+    }
+
+    // 取出n字节定长数据的起始位置，越界返回nullptr
+    const uint8_t *take(size_t n) {
+        if (!good || size_t(end - cursor) < n) {
+            fail();
+            return nullptr;
+        }
+        const uint8_t *at = cursor;
+        cursor += n;
+        return at;
+    }
+
+    bool getString(std::string &value) {
+        uint64_t length;
+        if (!getVarint(length) || length > uint64_t(end - cursor)) return fail();
+        value.assign(reinterpret_cast<const char *>(cursor), length);
+        cursor += length;
+        return true;
+    }
+
+    // 跳过一个字符串，不复制
+    bool skipString() {
+        uint64_t length;
+        if (!getVarint(length) || length > uint64_t(end - cursor)) return fail();
+        cursor += length;
+        return true;
+    }
+
+private:
+    bool fail() {
+        good = false;
+        return false;
+    }
+
+    const uint8_t *cursor;
+    const uint8_t *end;
+    bool good = true;
+};
+
+
+namespace wire {
+
+template<typename T, typename = void>
+struct HasFields : std::false_type {};
+
+template<typename T>
+struct HasFields<T, std::void_t<decltype(T::fields())>> : std::true_type {};
+
+template<typename T>
+constexpr bool isScalar = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+template<typename T>
+constexpr bool isFixed();
+
+template<typename T>
+constexpr size_t fixedSize();
+
+template<typename T>
+const uint8_t *decodeFixed(const uint8_t *in, T &value);
+
+namespace detail {
+
+template<typename Member>
+struct MemberType;
+
+template<typename Class, typename Field>
+struct MemberType<Field Class::*> {
+    using type = Field;
+};
+
+template<typename T, size_t... I>
+constexpr bool allFieldsFixed(std::index_sequence<I...>) {
+    using Fields = decltype(T::fields());
+    return (isFixed<typename MemberType<std::tuple_element_t<I, Fields>>::type>() && ...);
+}
+
+template<typename T, size_t... I>
+constexpr size_t sumFieldSizes(std::index_sequence<I...>) {
+    using Fields = decltype(T::fields());
+    return (size_t(0) + ... + fixedSize<typename MemberType<std::tuple_element_t<I, Fields>>::type>());
+}
+
+template<typename T, typename Fn>
+constexpr void forEachField(const T &value, Fn &&fn) {
+    std::apply([&](auto... member) { (fn(value.*member), ...); }, T::fields());
+}
+
+template<typename T, typename Fn>
+constexpr void forEachField(T &value, Fn &&fn) {
+    std::apply([&](auto... member) { (fn(value.*member), ...); }, T::fields());
+}
+
+template<typename T>
+constexpr size_t fieldCount() {
+    return std::tuple_size_v<decltype(T::fields())>;
+}
+
+}
+
+// 编码长度是否与取值无关
+template<typename T>
+constexpr bool isFixed() {
+    if constexpr (isScalar<T>) {
+        return true;
+    } else if constexpr (HasFields<T>::value) {
+        return detail::allFieldsFixed<T>(std::make_index_sequence<detail::fieldCount<T>()>{});
+    } else {
+        return false;
+    }
+}
+
+// 定长类型的编码长度，编译期求值
+template<typename T>
+constexpr size_t fixedSize() {
+    if constexpr (isScalar<T>) {
+        return sizeof(T);
+    } else if constexpr (HasFields<T>::value && isFixed<T>()) {
+        return detail::sumFieldSizes<T>(std::make_index_sequence<detail::fieldCount<T>()>{});
+    } else {
+        return 0;
+    }
+}
+
+// 编码后的精确字节数，定长类型在编译期求出
+template<typename T>
+constexpr size_t encodedSize(const T &value) {
+    if constexpr (isFixed<T>()) {
+        return fixedSize<T>();
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return varintSize(value.size()) + value.size();
+    } else {
+        static_assert(HasFields<T>::value, "type needs a fields() declaration to be serialized");
+        size_t total = 0;
+        detail::forEachField(value, [&total](const auto &field) { total += wire::encodedSize(field); });
+        return total;
+    }
+}
+
+// 写入预留好的空间，返回写入之后的位置
+template<typename T>
+uint8_t *encodeTo(uint8_t *out, const T &value) {
+    if constexpr (isScalar<T>) {
+        std::memcpy(out, &value, sizeof(T));
+        return out + sizeof(T);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        out = writeVarint(out, value.size());
+        std::memcpy(out, value.data(), value.size());
+        return out + value.size();
+    } else {
+        static_assert(HasFields<T>::value, "type needs a fields() declaration to be serialized");
+        detail::forEachField(value, [&out](const auto &field) { out = wire::encodeTo(out, field); });
+        return out;
+    }
+}
+
+template<typename T>
+void encode(WireWriter &w, const T &value) {
+    wire::encodeTo(w.grow(wire::encodedSize(value)), value);
+}
+
+template<typename T>
+bool decode(WireReader &r, T &value) {
+    if constexpr (isFixed<T>()) {
+        // 定长类型一次完成边界检查
+        const uint8_t *in = r.take(fixedSize<T>());
+        if (!in) return false;
+        wire::decodeFixed(in, value);
+        return true;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return r.getString(value);
+    } else {
+        static_assert(HasFields<T>::value, "type needs a fields() declaration to be serialized");
+        bool ok = true;
+        detail::forEachField(value, [&](auto &field) { ok = ok && wire::decode(r, field); });
+        return ok;
+    }
+}
+
+// 定长类型的解码，调用方已保证有fixedSize<T>()字节可读
+template<typename T>
+const uint8_t *decodeFixed(const uint8_t *in, T &value) {
+    if constexpr (isScalar<T>) {
+        if constexpr (std::is_same_v<T, bool>) {
+            value = *in != 0;
+        } else {
+            std::memcpy(&value, in, sizeof(T));
+        }
+        return in + sizeof(T);
+    } else {
+        detail::forEachField(value, [&in](auto &field) { in = wire::decodeFixed(in, field); });
+        return in;
+    }
+}
+
+}
+
+#endif //REGISTRYCPP_WIRE_H